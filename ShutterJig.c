@@ -1,7 +1,7 @@
 /*  Filename:       ShutterJig.c
     Author:         Corey Davyduke
     Created:        2012-06-14
-    Modified:       2012-07-31
+    Modified:       2026-10-17
     Compiler:       GNU GCC
     Description:    This project is based upon the "timer" project found
     under the Gel examples.  The HC11 uses the serial port to prompt the
@@ -13,116 +13,56 @@
 */
 
 #include "ShutterJig.h"
+#include "format.h"
+#include "sched.h"
+#include "buttons.h"
+#include "trace.h"
+#include "stats.h"
+#include "shutter.h"
+#include "endurance.h"
+#include "eeprom.h"
+#include "persist.h"
+#include "proto.h"
+#include "tune.h"
+
+// Send the display shadow every LCD_FLUSH_TICKS RTI periods.
+#define LCD_FLUSH_TICKS 5
+
+// Refresh the statistics line every STATS_TICKS RTI periods (1/4s).
+#define STATS_TICKS     ((unsigned char) (TIMER_TICK / 4))
 
-#define TIMER_DIV  (8192L)
-#define TIMER_TICK (M6811_CPU_E_CLOCK / TIMER_DIV)
-
-// Define the bits for Port A.
-#define PA0 (1<<0)
-#define PA1 (1<<1)
-#define PA2 (1<<2)
-#define PA3 (1<<3)
-#define PA4 (1<<4)
-#define PA5 (1<<5)
-#define PA6 (1<<6)
-#define PA7 (1<<7)
-
-#define LINE_1      0x80                // beginning position of LCD line 1
-#define LINE_2      0xC0                // beginning position of LCD line 2
-#define LINE_3      0x94                // beginning position of LCD line 3
-#define LINE_4      0xD4                // beginning position of LCD line 4
-
-// I/O Port Addresses
-#define LCD_CMD  *(unsigned char *)(0xB5F0)
-#define LCD_DAT  *(unsigned char *)(0xB5F1)
-
-// On and off times (in tenths of a second)
-#define ON_TIME   1
-#define OFF_TIME  3
-
-unsigned long timer_count;
 unsigned long boot_time;
 
-// Some shutter-related flags and counters.
-unsigned short shutter_opened;
-unsigned short shutter_closed;
-unsigned short open_shutter;
-unsigned short close_shutter;
-unsigned short on_count;
-unsigned short off_count;
+// Number of open and close commands given with the buttons.
+unsigned short button_open_count;
+unsigned short button_close_count;
 
 int __attribute__((noreturn)) main (void);
 void _start (void);
 
-// LCD function prototypes.
-void LCD_Command(unsigned char cval);
-void LCD_busy(void);
-void cprint(char dval);
-void LCDprint(char *sptr);
-void LCD_Initialize(void);
+// Idle share windows of the LCD clock line and of the W command.
+static sched_window_t clock_window;
+static sched_window_t wcet_window;
 
-// Function prototype for the button press routine.
-unsigned short ButtonPressed(void);
-
-// To be called before main();
+// To be called before main();  the host simulation build (make host)
+// starts through the C library instead.
+#ifndef SIM_HOST
 void _start()
 {
+  _io_ports[M6811_BPROT] = 0;           // unprotect the EEPROM, see eeprom.h
 	asm ("lds #_stack");
 //  _io_ports[M6811_OPTION] = 0x93;
 //  set_bus_expanded ();
   main ();
 }
-
-// Timer interrupt handler.
-void __attribute__((interrupt)) timer_interrupt(void)
-{
-  timer_count++;
-  timer_acknowledge();
-}
-
-// Returns the current number of ticks that ellapsed since we started.
-static inline unsigned long timer_get_ticks()
-{
-  unsigned long t;
-
-  lock();
-  t = timer_count;
-  unlock();
-  return t;
-}
-
-// Translate the number of ticks into some seconds.
-static unsigned long timer_seconds(unsigned long ntime)
-{
-  unsigned long n;
-
-  /* To compute SECS = NTIME * TIMER_DIV / M6811_CPU_E_CLOCK accurately,
-     use Bezous relation (A = BQ + R).  */
-  n = ntime * (TIMER_DIV / M6811_CPU_E_CLOCK);
-  n += (ntime * (TIMER_DIV % M6811_CPU_E_CLOCK)) / M6811_CPU_E_CLOCK;
-  n += boot_time;
-  return n;
-}
-
-// Translate the number of ticks into some microseconds.
-static unsigned long timer_microseconds(unsigned long ntime)
-{
-  unsigned long n;
-
-  /* To compute SECS = NTIME * TIMER_DIV / M6811_CPU_E_CLOCK accurately,
-     use Bezous relation (A = BQ + R).  */
-  n = ntime * (TIMER_DIV / 2);
-  n += (ntime * (TIMER_DIV % 2)) / 2;
-  n = n % 1000000L;
-  return n;
-}
+#endif
 
 /* Translate the string pointed to by *p into a number.
    Update *p to point to the end of that number.  */
-static unsigned short get_value(char **p)
+static unsigned long get_value(char **p)
 {
   char *q;
-  unsigned short val;
+  unsigned long val;
 
   q = *p;
   while(*q == ' ')
@@ -141,42 +81,22 @@ static unsigned short get_value(char **p)
   return val;
 }
 
-// Ask for the boot time.
-static void get_time()
+// Format a share in tenths of a percent as "58.3%".
+static char *fmt_share(char *p, unsigned short share)
 {
-  char buf[32];
-  int pos;
-  char c;
-  unsigned short hours, mins, secs;
+  p = fmt_u16(p, share / 10);
+  *p++ = '.';
+  *p++ = '0' + share % 10;
+  return fmt_str(p, "%");
+}
+
+// Parse a HH:MM:SS line and set the boot time from it.
+static void set_boot_time(char *buf)
+{
+  unsigned long hours, mins, secs;
   char *p;
   int error = 0;
 
-  print("\r\nBoot time ? ");
-  pos = 0;
-  while(1)
-  {
-    c = serial_recv();
-    if(c == '\r' || c == '\n')
-      break;
-
-    if(c == '\b')
-    {
-      print("\b \b");
-      pos--;
-      if(pos < 0)
-        pos = 0;
-    }
-    else if(pos < sizeof (buf) - 1)
-    {
-      buf[pos] = c;
-      buf[pos+1] = 0;
-      print(&buf[pos]);
-      pos++;
-    }
-  }
-
-  print("\n");
-  buf[pos] = 0;
   p = buf;
   hours = get_value(&p);
   if(*p++ != ':')
@@ -200,314 +120,721 @@ static void get_time()
   }
 }
 
-// Display the current time on the serial line.
-static void display_time(unsigned long ntime)
+// Parse a "P <on_us> <dead_us>" line and set the pulse timing from it.
+static void set_pulse_time(char *buf)
 {
-  unsigned long seconds;
-  unsigned short hours, mins;
-  unsigned long nus;
-  char time_display[20];
-  char tick_display[20];
+  unsigned long on_us, dead_us;
+  unsigned char ch;
+  char *p;
 
-  static unsigned long last_sec = 0xffffffff;
-  static unsigned long last_us = 0;
+  p = buf + 1;
+  on_us = get_value(&p);
+  dead_us = get_value(&p);
+  if(*p != 0 || on_us < PULSE_MIN_US || on_us > PULSE_MAX_US
+     || dead_us < PULSE_MIN_US || dead_us > PULSE_MAX_US)
+  {
+    print("Invalid pulse time.\r\n");
+    print("Format is: P <on_us> <dead_us>\r\n");
+    return;
+  }
 
-  // Translate the number of ticks in seconds and milliseconds.
-  seconds = timer_seconds(ntime);
-  nus = timer_microseconds(ntime);
+  // Takes effect with the next pulse of each channel.
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+  {
+    shutters[ch].on_us = on_us;
+    shutters[ch].dead_us = dead_us;
+  }
+  print("Pulse time is set.\r\n");
+}
 
-  // Get the raw number of "micro-seconds" before processing.
-  sprintf(tick_display, "t=%ld, %ld, %ld", timer_count, nus, seconds);
+// Parse an "O <channel>" or "C <channel>" line and give the command.
+static void set_shutter(char *buf, unsigned char cmd)
+{
+  unsigned long ch;
+  char *p;
 
-  // Write the timer count, microseconds, and seconds
-  // out to the LCD display for diagnostic purposes.
-  LCD_Command(LINE_3);               // goto lcd line 3
-  LCDprint(tick_display);
+  p = buf + 1;
+  ch = get_value(&p);
+  if(*p != 0 || ch < 1 || ch > SHUTTER_CHANNELS)
+  {
+    print("Invalid channel.\r\n");
+    print("Format is: O <channel> or C <channel>\r\n");
+    return;
+  }
+  shutter_command(ch - 1, cmd);
+}
 
-  nus = nus / 100000L;
+// Parse a "B <baud>" line and switch to the rate closest to it, or
+// report the rate in use with a lone "B".
+static void set_baud(char *buf)
+{
+  unsigned long baud;
+  char line[64];
+  char *p;
 
-  // If the seconds changed, re-display everything.
-  if(seconds != last_sec)
+  p = buf + 1;
+  baud = get_value(&p);
+  if(*p != 0 || (baud != 0 && sci_rate_find(baud) == SCI_RATES))
   {
-    last_sec = seconds;
-    last_us = nus;
-    hours = (unsigned short) (seconds / 3600L);
-    mins = (unsigned short) (seconds % 3600L);
-    seconds = (unsigned long) (mins % 60);
-    mins = mins / 60;
-    time_display[0] = '0' + (hours / 10);
-    time_display[1] = '0' + (hours % 10);
-    time_display[2] = ':';
-    time_display[3] = '0' + (mins / 10);
-    time_display[4] = '0' + (mins % 10);
-    time_display[5] = ':';
-    time_display[6] = '0' + (seconds / 10);
-    time_display[7] = '0' + (seconds % 10);
-    time_display[8] = 0;
-    serial_print("\r");
-    serial_print(time_display);
+    print("Invalid baud rate.\r\n");
+    print("Format is: B <baud>\r\n");
+    return;
+  }
 
-    // Write the clock time out to the LCD display.
-    LCD_Command(LINE_2);               // goto lcd line 2
-    LCDprint(time_display);
+  if(baud == 0)
+  {
+    p = fmt_str(line, "Baud rate is ");
+    p = fmt_u32(p, sci_baud());
+    fmt_str(p, ".\r\n");
+    print(line);
+    return;
   }
 
-  // Do this stuff every tenth of a second.
-  else if(last_us != nus)
+  baud = sci_rates[sci_rate_find(baud)].baud;
+  if(!sci_baud_request(baud))
   {
-    last_us = nus;
-
-	  // If the open shutter flag has been set and the shutter is not already in the opened position,
-	  // turn on the appropriate half of the H-bridge driver for the desired number of milliseconds.
-	  if(open_shutter)
-	  {
-      // If the user is requesting that the shutter be opened, then we must be moving away from the
-      // shutter closed position.
-      close_shutter = 0;
-      shutter_closed = 0;
-
-      // If the shutter is not already opened, then enable the open pulse for the desired pulse duration.
-      if(!shutter_opened)
-      {
-        // If the duration is still not yet acheived, keep the pulse on.
-        if(on_count < ON_TIME)
-        {
-          // Open the shutter.
-          _io_ports[M6811_PORTA] &= ~PA4;
-          _io_ports[M6811_PORTA] |= PA5;
-
-          // Increase the counter to indicate the number of ms the pulse has been asserted.
-          on_count++;
-        }
-
-        // If the pulse has been on for the required number of ms, put the H-bridge back into idle
-        // for a minimum amount of time before accepting a new command to open the shutter.
-        else if(off_count < OFF_TIME)
-        {
-          // Bring the H-bridge driver back into the idle state.
-          _io_ports[M6811_PORTA] &= ~PA4;
-          _io_ports[M6811_PORTA] &= ~PA5;
-          
-          // Increase the counter to indicate the number of ms the pulse has been de-asserted.
-          off_count++;
-        }
-        
-        else
-        {
-          // After the pulse has been on for the desired amount of time and then off for the minimum
-          // amount of time, reset the open shutter flag, the pulse delay counters, and signal that 
-          // the shutter is now opened.
-          on_count = 0;
-          off_count = 0;
-          open_shutter = 0;
-          shutter_opened = 1;
-        }
-      }
+    print("A baud rate change is in progress.\r\n");
+    return;
+  }
+  p = fmt_str(line, "Switching to ");
+  p = fmt_u32(p, baud);
+  fmt_str(p, " baud, type Y at the new rate within 5s.\r\n");
+  print(line);
+}
 
-      // If the shutter is already opened, reset the open shutter flag.
-      else
-      {
-        open_shutter = 0;
-      }
-    }
+// Report the endurance run of each channel.
+static void show_endurance(void)
+{
+  static const char * const status_names[] =
+  {
+    "running", "stopped", "done", "fault"
+  };
+  char line[72];
+  char *p;
+  unsigned char ch;
 
-	  // If the close shutter flag has been set and the shutter is not already in the closed position,
-	  // turn on the appropriate half of the H-bridge driver for the desired number of milliseconds.
-    if(close_shutter)
-    {
-      // If the user is requesting that the shutter be closed, then we must be transitioning from the
-      // shutter opened position.
-      open_shutter = 0;
-      shutter_opened = 0;
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+  {
+    p = fmt_str(line, "E");
+    *p++ = '1' + ch;
+    p = fmt_str(p, " ");
+    p = fmt_str(p, status_names[endurance[ch].status]);
+    p = fmt_str(p, " cycles=");
+    p = fmt_u32(p, endurance[ch].cycles);
+    p = fmt_str(p, " rate=");
+    p = fmt_u32(p, endurance_rate(ch));
+    p = fmt_str(p, "/min total=");
+    p = fmt_u32(p, endurance[ch].total);
+    fmt_str(p, "\r\n");
+    print(line);
+  }
+}
 
-      // If the shutter is not already closed, then enable the close pulse for the desired pulse duration.
-      if(!shutter_closed)
-      {
-        // If the duration is still not yet acheived, keep the pulse on.
-        if(on_count < ON_TIME)
-        {
-          // Close the shutter.
-          _io_ports[M6811_PORTA] |= PA4;
-          _io_ports[M6811_PORTA] &= ~PA5;
-
-          // Increase the counter to indicate the number of ms the pulse has been asserted.
-          on_count++;
-        }
-
-        // If the pulse has been on for the required number of ms, put the H-bridge back into idle
-        // for a minimum amount of time before accepting another command to close the shutter.
-        else if(off_count < OFF_TIME)
-        {
-          // Bring the H-bridge driver back into the idle state.
-          _io_ports[M6811_PORTA] &= ~PA4;
-          _io_ports[M6811_PORTA] &= ~PA5;
-
-          // Increase the counter to indicate the number of ms the pulse has been de-asserted.
-          off_count++;
-        }
-
-        else
-        {
-          // After the pulse has been on for the desired amount of time and then off for the minimum 
-          // amount of time, reset the close shutter flag, the pulse delay counters, and signal that 
-          // the shutter is now closed.
-          on_count = 0;
-          off_count = 0;
-          close_shutter = 0;
-          shutter_closed = 1;
-        }
-      }
+// Parse an "E <channel> <cycles> [<period_ms>]" line and start cycling
+// the channel, "E <channel>" to stop it or a lone "E" to report.
+static void set_endurance(char *buf)
+{
+  unsigned long ch, target, period_ms;
+  char *p;
 
-      // If the shutter is already closed, reset the close shutter flag.
-      else
-      {
-        close_shutter = 0;
-      }
-    }
+  p = buf + 1;
+  while(*p == ' ')
+    p++;
+  if(*p == 0)
+  {
+    show_endurance();
+    return;
+  }
+
+  ch = get_value(&p);
+  if(ch >= 1 && ch <= SHUTTER_CHANNELS && *p == 0)
+  {
+    endurance_stop(ch - 1);
+    print("Endurance run is stopped.\r\n");
+    return;
   }
+  target = get_value(&p);
+  period_ms = get_value(&p);
+  if(*p != 0 || ch < 1 || ch > SHUTTER_CHANNELS
+     || !endurance_start(ch - 1, target, period_ms))
+  {
+    print("Invalid endurance run.\r\n");
+    print("Format is: E <channel> <cycles> [<period_ms>]\r\n");
+    return;
+  }
+  print("Endurance run is started.\r\n");
+}
 
-  serial_flush();
+#ifdef SENSE_ENABLE
+// Report the tuned times of channel 0, as
+// "open on=50000us dead=5000us travel=40000us margin=25%".
+static void show_tune(void)
+{
+  static const char * const names[2] = { "open", "close" };
+  char line[80];                      // 73 with every field at its widest
+  char *p;
+  unsigned char i;
+
+  for(i = 0; i < 2; i++)
+  {
+    p = fmt_str(line, names[i]);
+    p = fmt_str(p, " on=");
+    p = fmt_u32(p, tune.on_us[i]);
+    p = fmt_str(p, "us dead=");
+    p = fmt_u32(p, tune.dead_us[i]);
+    p = fmt_str(p, "us travel=");
+    p = fmt_u32(p, tune.travel[i] * TB_US_PER_TICK);
+    p = fmt_str(p, "us margin=");
+    p = fmt_u16(p, tune.margin[i] * 25 / 4);
+    fmt_str(p, "%\r\n");
+    print(line);
+  }
+  p = fmt_str(line, tune.on ? "tuning, " : "not tuning, ");
+  p = fmt_u16(p, tune.misses);
+  fmt_str(p, " misses\r\n");
+  print(line);
 }
 
-// Wait for the LCD busy pin to clear
-void LCD_busy()
+// Parse an "A 1" line to tune the channel 0 pulse times from the times
+// set with P, "A 0" to go back to the times set with P, or a lone "A"
+// to report.
+static void set_tune(char *buf)
 {
-  while ((LCD_CMD & 0x80)) ;
+  unsigned long on;
+  char *p;
+
+  p = buf + 1;
+  while(*p == ' ')
+    p++;
+  if(*p == 0)
+  {
+    show_tune();
+    return;
+  }
+
+  on = get_value(&p);
+  if(*p != 0 || on > 1)
+  {
+    print("Invalid tuning.\r\n");
+    print("Format is: A 1 or A 0\r\n");
+    return;
+  }
+  if(on)
+  {
+    tune_start();
+    print("Tuning is started.\r\n");
+  }
+  else
+  {
+    tune.on = 0;
+    print("Tuning is stopped.\r\n");
+  }
 }
+#endif
 
-void LCD_Command(unsigned char cval)
+// Report the last pulse of each channel with a current sense, as
+// "1 open n=97 peak=1850mA mean=1620mA 12040mV 975mJ".
+static void show_pulses(void)
 {
-  LCD_busy();                         // wait for busy to clear
-  LCD_CMD = cval;                     // ouptut command
+  const adc_pulse_t *r;
+  char line[64];
+  char *p;
+  unsigned char ch;
+
+  for(ch = 0, r = adc_pulses; ch < ADC_CHANNELS; ch++, r++)
+  {
+    p = line;
+    *p++ = '1' + ch;
+    if(r->seq == 0)
+    {
+      fmt_str(p, " -\r\n");
+      print(line);
+      continue;
+    }
+    p = fmt_str(p, r->direction == PULSE_OPEN ? " open n=" : " close n=");
+    p = fmt_u16(p, r->samples);
+    p = fmt_str(p, " peak=");
+    p = fmt_u16(p, r->peak_ma);
+    p = fmt_str(p, "mA mean=");
+    p = fmt_u16(p, r->mean_ma);
+    p = fmt_str(p, "mA ");
+    p = fmt_u16(p, r->supply_mv);
+    p = fmt_str(p, "mV ");
+    p = fmt_u32(p, r->energy_mj);
+    fmt_str(p, "mJ\r\n");
+    print(line);
+  }
 }
 
-void LCD_Initialize(void)
+// Parse a "G 0" line to clear the fault latched by the supervisor, or
+// report it with a lone "G", as "on time 2, 3 faults".
+static void set_guard(char *buf)
 {
-  // Initialize the LCD
-  LCD_Command(0x3C);                 // initialize command
-  LCD_Command(0x0C);                 // display on, cursor off
-  LCD_Command(0x06);
-  LCD_Command(0x01);
+  static const char * const names[3] = { "ok", "overlap ", "on time " };
+  unsigned long value;
+  char line[40];
+  char *p;
+
+  p = buf + 1;
+  while(*p == ' ')
+    p++;
+  if(*p == 0)
+  {
+    p = fmt_str(line, names[guard.fault]);
+    if(guard.fault != GUARD_OK)
+      *p++ = '1' + guard.channel;
+    p = fmt_str(p, ", ");
+    p = fmt_u16(p, guard.faults);
+    fmt_str(p, " faults\r\n");
+    print(line);
+    return;
+  }
+
+  value = get_value(&p);
+  if(*p != 0 || value != 0)
+  {
+    print("Invalid guard command.\r\n");
+    print("Format is: G 0\r\n");
+    return;
+  }
+  guard_clear();
+  print("Guard fault is cleared.\r\n");
 }
 
-// LCD Display Character
-void cprint(char dval)
+// Report the longest run of each task, then the idle share and the
+// number of waits since the previous W.
+static void show_wcet(void)
 {
-  LCD_busy();                         // wait for busy to clear
-  LCD_DAT = dval;                     // ouptut data
+  char line[40];
+  char *p;
+  unsigned char i;
+
+  for(i = 0; i < sched_count; i++)
+  {
+    p = fmt_str(line, sched_tasks[i].name);
+    p = fmt_str(p, " ");
+    p = fmt_u32(p, sched_wcet[i] * TB_US_PER_TICK);
+    fmt_str(p, "us\r\n");
+    print(line);
+  }
+
+  p = fmt_str(line, "idle ");
+  p = fmt_share(p, sched_idle_share(&wcet_window));
+  p = fmt_str(p, " waits ");
+  p = fmt_u32(p, sched_waits);
+  fmt_str(p, "\r\n");
+  print(line);
+  sched_waits = 0;
 }
 
-// LCD Display String
-void LCDprint(char *sptr)
+// Report one latency figure in microseconds: the count, minimum, mean,
+// maximum and, with hist, the histogram buckets that are not empty, each
+// one by the lowest value it holds.
+static void show_acc(const char *name, const stats_acc_t *acc,
+                     unsigned char hist)
 {
-	while( *sptr )
+  stats_acc_t copy;
+  char line[72];
+  char *p;
+  unsigned char i;
+
+  stats_copy(&copy, acc);
+  p = fmt_str(line, name);
+  p = fmt_str(p, " n=");
+  p = fmt_u32(p, copy.count);
+  if(copy.count)
+  {
+    p = fmt_str(p, " min=");
+    p = fmt_u32(p, copy.min * TB_US_PER_TICK);
+    p = fmt_str(p, " avg=");
+    p = fmt_u32(p, stats_mean(&copy) * TB_US_PER_TICK);
+    p = fmt_str(p, " max=");
+    p = fmt_u32(p, copy.max * TB_US_PER_TICK);
+    p = fmt_str(p, "us");
+  }
+  fmt_str(p, "\r\n");
+  print(line);
+  if(!hist)
+    return;
+
+  for(i = 0; i < STATS_BUCKETS; i++)
   {
-		cprint(*sptr);
-		++sptr;
-	}
+    if(copy.hist[i] == 0)
+      continue;
+    p = fmt_str(line, " ");
+    p = fmt_u32(p, i ? (1L << (i - 1)) * TB_US_PER_TICK : 0);
+    p = fmt_str(p, ":");
+    p = fmt_u16(p, copy.hist[i]);
+    print(line);
+  }
+  print("\r\n");
 }
 
-// returns 1 if a key is pressed.
-// the key value/index is stored in the global variable NewKey.
-unsigned short ButtonPressed(void)
+// Report the latency statistics.  With the sensors channel 0 has no
+// buttons, so the travel times take the place of the press to coil
+// latency; they all fall in one or two buckets, so the histogram is
+// left out.
+static void show_stats(void)
 {
-  unsigned short buttons = 0;
-  buttons = _io_ports[M6811_PORTA] & 0x07;
-  return buttons;
+#ifdef SENSE_ENABLE
+  char line[40];
+  char *p;
+#endif
+
+  show_acc("rti late", &stats_rti, 1);
+#ifndef SENSE_ENABLE
+  show_acc("press to coil", &stats_coil, 1);
+#else
+  show_acc("open travel", &stats_travel[0], 0);
+  show_acc("close travel", &stats_travel[1], 0);
+  p = fmt_str(line, "stalls ");
+  p = fmt_u16(p, sense.stalls);
+  p = fmt_str(p, " cut short ");
+  p = fmt_u16(p, sense.cuts);
+  fmt_str(p, "\r\n");
+  print(line);
+#endif
 }
 
-int main()
+// Ask for the boot time or a command.  This is a line editor that
+// consumes whatever the SCI interrupt has received so far and returns
+// at once; it runs whenever the SCI interrupt receives something.  The
+// first character of a line brings up the prompt.  Between two lines
+// the binary protocol gets the first look at each character.
+static void get_time()
 {
-  unsigned long prev_time;
-  unsigned short buttons = 0;
-  unsigned short button_open = 0;
-  unsigned short button_close = 0;
-  unsigned short button_clear = 0;
-  unsigned short button_open_count = 0;
-  unsigned short button_close_count = 0;
-  char button_display[20];
-
-  serial_init();
-  lock();
-  boot_time = 0;
-  timer_count = 0;
+  static char buf[32];
+  static int pos;
+  static unsigned char editing;
+  char c;
 
-  // Set the shutter flags and counters to zero to start off with.
-  shutter_opened = 0;
-  shutter_closed = 0;
-  open_shutter = 0;
-  close_shutter = 0;
-  on_count = 0;
-  off_count = 0;
+  while(sci_getc(&c))
+  {
+    // Only a Y or a frame at the new rate confirms it; anything else is
+    // taken for noise.
+    if(sci_baud_waiting())
+    {
+      if(!proto_rx(c) && (c == 'Y' || c == 'y') && sci_baud_confirm())
+        print("Baud rate is set.\r\n");
+      continue;
+    }
 
-  // Set interrupt handler for bootstrap mode.
-  set_interrupt_handler(RTI_VECTOR, timer_interrupt);
+    if(!editing)
+    {
+      if(proto_rx(c))
+        continue;
+
+      // A lone end of line (the LF of a CR/LF pair) does not start a line.
+      if(c == '\r' || c == '\n')
+        continue;
+
+#ifdef PROTO_ENABLE
+      proto_active = 0;
+#endif
+      print("\r\nBoot time (or P on dead, O ch, C ch, E ch n ms, B baud, I, G, W, S, Z) ? ");
+      pos = 0;
+      editing = 1;
+    }
 
-  // Initialize the timer.
-  timer_initialize_rate(M6811_TPR_16);
-  prev_time = timer_count;
+    if(c == '\r' || c == '\n')
+    {
+      print("\n");
+      buf[pos] = 0;
+      editing = 0;
+      if(buf[0] == 'P' || buf[0] == 'p')
+        set_pulse_time(buf);
+      else if(buf[0] == 'O' || buf[0] == 'o')
+        set_shutter(buf, SHUTTER_CMD_OPEN);
+      else if(buf[0] == 'C' || buf[0] == 'c')
+        set_shutter(buf, SHUTTER_CMD_CLOSE);
+      else if(buf[0] == 'E' || buf[0] == 'e')
+        set_endurance(buf);
+#ifdef SENSE_ENABLE
+      else if(buf[0] == 'A' || buf[0] == 'a')
+        set_tune(buf);
+#endif
+      else if(buf[0] == 'B' || buf[0] == 'b')
+        set_baud(buf);
+      else if(buf[0] == 'I' || buf[0] == 'i')
+        show_pulses();
+      else if(buf[0] == 'G' || buf[0] == 'g')
+        set_guard(buf);
+      else if(buf[0] == 'W' || buf[0] == 'w')
+        show_wcet();
+      else if(buf[0] == 'S' || buf[0] == 's')
+        show_stats();
+      else if(buf[0] == 'Z' || buf[0] == 'z')
+      {
+        stats_init();
+        proto_clear();
+        print("Statistics are cleared.\r\n");
+      }
+#ifdef TRACE_ENABLE
+      else if(buf[0] == 'T' || buf[0] == 't')
+        trace_dump();
+#endif
+      else
+        set_boot_time(buf);
+    }
+    else if(c == '\b')
+    {
+      print("\b \b");
+      pos--;
+      if(pos < 0)
+        pos = 0;
+    }
+    else if(pos < sizeof (buf) - 1)
+    {
+      buf[pos] = c;
+      sci_putc(c);
+      pos++;
+    }
+  }
+}
 
-  unlock();
+// Display the current time on the serial line, and on the LCD with the
+// share of the last second spent waiting for interrupts.  Runs on every
+// RTI tick.
+static void display_time(void)
+{
+  tb_clock_t clock;
+  unsigned long seconds;
+  char time_display[20];
+  char *p;
 
-  // Get the LCD ready for use.
-  LCD_Initialize();
+  static unsigned long last_sec = 0xffffffff;
 
-  // Print the "welcome" message out the serial port and on the LCD.
-  print("\nHello, world!\n");
-  LCD_Command(LINE_1);               // goto lcd line 1
-  LCDprint("Hello, world!");
+  TRACE(TRACE_CLOCK);
 
-  // Loop waiting for the time to change and redisplay it.
-  while(1)
+  // The RTI handler keeps the seconds and microseconds up to date.
+  timebase_clock(&clock);
+  seconds = clock.seconds + boot_time;
+
+  // If the seconds changed, re-display everything.
+  if(seconds != last_sec)
   {
-    unsigned long ntime;
+    last_sec = seconds;
+    p = fmt_hms(time_display, seconds);
+    if(!trace_busy() && !proto_active)
+    {
+      serial_print("\r");
+      serial_print(time_display);
+    }
 
-    // Reset the COP (in case it is active).
-    cop_optional_reset();
+    // Write the clock time out to the LCD display.
+    p = fmt_str(p, " i");
+    fmt_share(p, sched_idle_share(&clock_window));
+    LCD_WriteLine(1, time_display);    // lcd line 2
+  }
 
-    /* If something is received on the serial line,
-       ask for the boot time again.  */
-    if(serial_receive_pending())
-      get_time();
+  TRACE(TRACE_CLOCK_END);
+}
 
-    buttons = ButtonPressed();
+// Follow a baud rate change, and say so when the old rate comes back.
+static void baud_task(void)
+{
+  char line[40];
+  char *p;
 
-    button_open = buttons & PA0;
-    button_close = buttons & PA1;
-    button_clear = buttons & PA2;
+  if(sci_baud_task() != SCI_BAUD_REVERTED || proto_active)
+    return;
+  p = fmt_str(line, "Baud rate is back to ");
+  p = fmt_u32(p, sci_baud());
+  fmt_str(p, ".\r\n");
+  print(line);
+}
 
-    // If the shutter open button has been pressed, assert the shutter open flag.
-    if(button_open)
-    {
-      open_shutter = 1;
-      button_open_count++;
-    }
+// Show the mean and worst RTI lateness and press to coil latency, in
+// microseconds, for qualifying the firmware against its latency budget.
+static void stats_task(void)
+{
+  stats_acc_t copy;
+  char stats_display[32];             // "r65535/65535 c524280/524280"
+  char *p;
+
+  stats_copy(&copy, &stats_rti);
+  p = fmt_str(stats_display, "r");
+  p = fmt_u16(p, stats_mean(&copy) * TB_US_PER_TICK);
+  p = fmt_str(p, "/");
+  p = fmt_u16(p, copy.max * TB_US_PER_TICK);
+
+  stats_copy(&copy, &stats_coil);
+  p = fmt_str(p, " c");
+  if(copy.count)
+  {
+    p = fmt_u32(p, stats_mean(&copy) * TB_US_PER_TICK);
+    p = fmt_str(p, "/");
+    fmt_u32(p, copy.max * TB_US_PER_TICK);
+  }
+  else
+  {
+    fmt_str(p, "-");
+  }
+  LCD_WriteLine(2, stats_display);    // lcd line 3
+}
+
+// What each button does: the channel in the high nibble and the shutter
+// command in the low one.  BUTTON_CLEAR and the unused bit 3 do not go
+// to a channel.  Channel 3 only takes serial commands.
+#define BUTTON_TO(CH, CMD)  (((CH) << 4) | (CMD))
+#define BUTTON_OTHER        0xFF
+
+static const unsigned char button_map[BUTTON_COUNT] =
+{
+  BUTTON_TO(0, SHUTTER_CMD_OPEN),       // BUTTON_OPEN
+  BUTTON_TO(0, SHUTTER_CMD_CLOSE),      // BUTTON_CLOSE
+  BUTTON_OTHER,                         // BUTTON_CLEAR
+  BUTTON_OTHER,
+  BUTTON_TO(1, SHUTTER_CMD_OPEN),       // BUTTON_OPEN1
+  BUTTON_TO(1, SHUTTER_CMD_CLOSE),      // BUTTON_CLOSE1
+  BUTTON_TO(2, SHUTTER_CMD_OPEN),       // BUTTON_OPEN2
+  BUTTON_TO(2, SHUTTER_CMD_CLOSE)       // BUTTON_CLOSE2
+};
+
+// Act on the button events and show the state of each channel.
+static void button_task(void)
+{
+  unsigned char event, button, map, ch;
+  char shutter_display[24];
+  char *p;
+
+  while((event = buttons_get()) != 0)
+  {
+    if(BUTTON_TYPE(event) != BUTTON_PRESS)
+      continue;
+    button = BUTTON_NUM(event);
+    TRACE(TRACE_PRESS + button);
 
-    // If the shutter close button has been pressed, assert the shutter close flag.
-    if(button_close)
-    {
-      close_shutter = 1;
-      button_close_count++;
-    }
-    
     // If you push the "clear" button, then that means you want the counts to go back to zero.
-    if(button_clear)
+    if(button == BUTTON_CLEAR)
     {
       button_open_count = 0;
       button_close_count = 0;
+      continue;
     }
 
-    // Display the buttons for diagnostic purposes.
-    sprintf(button_display,"b=%d,%d,%d,%d,%d,%d", button_open, button_close, open_shutter, close_shutter, shutter_opened, shutter_closed);
-    LCD_Command(LINE_4);               // goto lcd line 1
-    LCDprint(button_display);
+    map = button_map[button];
+    if(map == BUTTON_OTHER)
+      continue;
 
-    // Get current time and see if we must re-display it.
-    ntime = timer_get_ticks();
-    if(ntime != prev_time)
-    {
-      prev_time = ntime;
-      display_time(ntime);
-    }
+    // Open or close the shutter of the channel.
+    if((map & 0x0F) == SHUTTER_CMD_OPEN)
+      button_open_count++;
+    else
+      button_close_count++;
+    if((map >> 4) == 0)
+      stats_press(buttons_edge(button));
+    shutter_command(map >> 4, map & 0x0F);
+  }
+
+  // Show the state of each channel, as "1:OP 2:CL 3:-- 4:C>".
+  p = shutter_display;
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+  {
+    if(ch)
+      *p++ = ' ';
+    *p++ = '1' + ch;
+    *p++ = ':';
+    p = fmt_str(p, shutter_state_name(shutters[ch].state));
   }
+  LCD_WriteLine(3, shutter_display);  // lcd line 4
+}
+
+// The tasks, in the order they run within a pass.  The buttons come
+// first so a command they queue is seen by the shutter task in the
+// same pass, and the endurance task follows the shutter task so it
+// sees a channel at rest as soon as it gets there.
+static const sched_task_t tasks[] =
+{
+  { "buttons", button_task,    SCHED_EV_BUTTON | SCHED_EV_TICK, 0 },
+  { "shutter", shutter_update, SCHED_EV_TICK | SCHED_EV_PULSE,  0 },
+  { "endure",  endurance_task, SCHED_EV_TICK | SCHED_EV_PULSE,  0 },
+  { "adc",     adc_task,       SCHED_EV_TICK | SCHED_EV_PULSE,  0 },
+  { "clock",   display_time,   SCHED_EV_TICK,                   0 },
+  { "stats",   stats_task,     0,                               STATS_TICKS },
+  { "eeprom",  persist_task,   SCHED_EV_TICK,                   0 },
+#ifdef PROTO_ENABLE
+  { "proto",   proto_task,     SCHED_EV_TICK,                   0 },
+#endif
+  { "baud",    baud_task,      SCHED_EV_TICK,                   0 },
+  { "serial",  get_time,       SCHED_EV_RX,                     0 },
+  { "lcd",     LCD_Flush,      0,                               LCD_FLUSH_TICKS },
+#ifdef TRACE_ENABLE
+  { "trace",   trace_task,     SCHED_EV_TICK,                   0 }
+#endif
+};
+
+#define TASK_COUNT (sizeof (tasks) / sizeof (tasks[0]))
+
+// Fails to compile if the table outgrows the arrays of sched.c.
+typedef char tasks_fit_sched[TASK_COUNT <= SCHED_MAX_TASKS ? 1 : -1];
+
+int main()
+{
+  unsigned char restored;
+
+#ifdef SIM_HOST
+  // There is no _start on the host; its clock only starts with the
+  // first lock(), so BPROT can still be written here.
+  _io_ports[M6811_BPROT] = 0;
+#endif
+  lock();
+  sci_init();
+  boot_time = 0;
+  sched_events = 0;
+
+  // The shutter position is unknown until the first command.
+  shutter_init();
+  endurance_init();
+
+  // The pulse times and lifetime counts saved in the EEPROM, if any.
+  restored = persist_init();
+  tune_init();
+  button_open_count = 0;
+  button_close_count = 0;
+  buttons_init();
+  trace_init();
+  stats_init();
+  proto_init();
+
+  // Set interrupt handler for bootstrap mode.
+  set_interrupt_handler(RTI_VECTOR, timer_interrupt);
+  set_interrupt_handler(TIMER_OVERFLOW_VECTOR, timebase_overflow_interrupt);
+  set_interrupt_handler(TIMER_OUTPUT2_VECTOR, lcd_interrupt);
+  set_interrupt_handler(SCI_VECTOR, sci_interrupt);
+  set_interrupt_handler(TIMER_OUTPUT3_VECTOR, pulse_interrupt);
+  set_interrupt_handler(TIMER_OUTPUT4_VECTOR, pulse_interrupt);
+  set_interrupt_handler(TIMER_OUTPUT5_VECTOR, adc_interrupt);
+  set_interrupt_handler(TIMER_OUTPUT1_VECTOR, guard_interrupt);
+#ifdef SENSE_ENABLE
+  set_interrupt_handler(TIMER_INPUT2_VECTOR, sense_interrupt);
+  set_interrupt_handler(TIMER_INPUT3_VECTOR, sense_interrupt);
+#endif
+
+  // Initialize the timer.
+  timer_initialize_rate(M6811_TPR_16);
+  timebase_init();
+
+  // Both halves of the H-bridge start off, under the supervisor.
+  pulse_init();
+  sense_init();
+  adc_init();
+  guard_init();
+
+  sched_window_start(&clock_window);
+  sched_window_start(&wcet_window);
+  unlock();
+
+  // Get the LCD ready for use.  The commands are sent in the
+  // background by the output compare 2 interrupt.
+  LCD_Initialize();
+
+  // Print the "welcome" message out the serial port and on the LCD.
+  print("\nHello, world!\n");
+  LCD_WriteLine(0, "Hello, world!");  // lcd line 1
+  if(restored)
+    print("Settings are restored.\n");
+
+  // Run the tasks forever.
+  sched_run(tasks, TASK_COUNT);
 }
@@ -1,7 +1,7 @@
 /*  Filename:       ShutterBits.h
     Author:         Corey Davyduke
     Created:        2012-06-14
-    Modified:       2012-06-18
+    Modified:       2026-10-17
     Compiler:       GNU GCC
     Description:    This is the header file for the Shutter Jig project.
 */
@@ -15,7 +15,46 @@
 #include <locks.h>
 #include <stdarg.h>
 
-extern void timer_interrupt (void) __attribute__((interrupt));
+/* Define the bits for Port A.  */
+#define PA0 (1<<0)
+#define PA1 (1<<1)
+#define PA2 (1<<2)
+#define PA3 (1<<3)
+#define PA4 (1<<4)
+#define PA5 (1<<5)
+#define PA6 (1<<6)
+#define PA7 (1<<7)
+
+/* Define the bits of Port D used as outputs and of Port E used as
+   inputs.  */
+#define PD2 (1<<2)
+#define PD3 (1<<3)
+#define PD4 (1<<4)
+#define PD5 (1<<5)
+#define PE4 (1<<4)
+#define PE5 (1<<5)
+#define PE6 (1<<6)
+#define PE7 (1<<7)
+
+/* The RTI fires every TIMER_DIV E clocks.  */
+#define TIMER_DIV  (8192L)
+#define TIMER_TICK (M6811_CPU_E_CLOCK / TIMER_DIV)
+
+/* The free running counter is prescaled by 16 (see timer_initialize_rate
+   in main), so TCNT advances once every TCNT_DIV E clocks.  */
+#define TCNT_DIV   (16L)
+#define TCNT_RATE  (M6811_CPU_E_CLOCK / TCNT_DIV)
+
+/* Convert a constant number of microseconds into TCNT ticks.  */
+#define US_TO_TCNT(US) ((unsigned short) (((US) * (TCNT_RATE / 1000L)) / 1000L))
+
+#include "timebase.h"
+#include "lcd.h"
+#include "sci.h"
+#include "pulse.h"
+#include "sense.h"
+#include "adc.h"
+#include "guard.h"
 
 #ifdef USE_INTERRUPT_TABLE
 
@@ -38,18 +77,23 @@ struct interrupt_vectors __attribute__((section(".vectors"))) vectors =
   res8_handler:           fatal_interrupt,
   res9_handler:           fatal_interrupt,
   res10_handler:          fatal_interrupt, /* res 10 */
-  sci_handler:            fatal_interrupt, /* sci */
+  sci_handler:            sci_interrupt,   /* sci */
   spi_handler:            fatal_interrupt, /* spi */
   acc_overflow_handler:   fatal_interrupt, /* acc overflow */
   acc_input_handler:      fatal_interrupt,
-  timer_overflow_handler: fatal_interrupt,
-  output5_handler:        fatal_interrupt, /* out compare 5 */
-  output4_handler:        fatal_interrupt, /* out compare 4 */
-  output3_handler:        fatal_interrupt, /* out compare 3 */
-  output2_handler:        fatal_interrupt, /* out compare 2 */
-  output1_handler:        fatal_interrupt, /* out compare 1 */
+  timer_overflow_handler: timebase_overflow_interrupt,
+  output5_handler:        adc_interrupt,   /* out compare 5 */
+  output4_handler:        pulse_interrupt, /* out compare 4 */
+  output3_handler:        pulse_interrupt, /* out compare 3 */
+  output2_handler:        lcd_interrupt,   /* out compare 2 */
+  output1_handler:        guard_interrupt, /* out compare 1 */
+#ifdef SENSE_ENABLE
+  capture3_handler:       sense_interrupt, /* in capt 3 */
+  capture2_handler:       sense_interrupt, /* in capt 2 */
+#else
   capture3_handler:       fatal_interrupt, /* in capt 3 */
   capture2_handler:       fatal_interrupt, /* in capt 2 */
+#endif
   capture1_handler:       fatal_interrupt, /* in capt 1 */
   irq_handler:            fatal_interrupt, /* IRQ */
   xirq_handler:           fatal_interrupt, /* XIRQ */
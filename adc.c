@@ -0,0 +1,165 @@
+/*  Filename:       adc.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Coil current monitor.
+
+    The converter runs in continuous scan mode on PE0..PE3, so ADR1 to
+    ADR4 always hold a conversion less than 64 E clocks old and reading
+    them costs nothing.  The sample clock is output compare 5, whose pin
+    action is left off; it only runs while a channel has a pulse to
+    watch.  Its handler adds each sample into running sums (current,
+    voltage, their product and the peak) and keeps nothing else, so a
+    pulse of any length takes the same few bytes.
+
+    When the pin of a channel goes off the handler marks its sums ready,
+    and adc_task turns them into a record in mA, mV and mJ.  The divides
+    are done there, in the main loop, on 32-bit sums that cannot
+    overflow within the longest pulse (PULSE_MAX_US).
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "adc.h"
+
+#define ADC_IDLE        0
+#define ADC_WAIT        1               // the pulse is asked for, pin not on yet
+#define ADC_ON          2
+#define ADC_READY       3               // the pulse ended, for adc_task
+
+/*! Running sums of a pulse, in counts.  */
+struct adc_acc
+{
+  volatile unsigned char state;
+  unsigned char direction;
+  unsigned char peak;
+  unsigned short samples;
+  unsigned long sum_i;
+  unsigned long sum_v;
+  unsigned long sum_p;                  // current times voltage
+};
+
+adc_pulse_t adc_pulses[ADC_CHANNELS];
+
+static struct adc_acc adc_acc[ADC_CHANNELS];
+
+// Power up the converter and start scanning PE0..PE3.
+void adc_init(void)
+{
+  unsigned short mask;
+  unsigned char ch;
+
+  mask = lock();
+  for(ch = 0; ch < ADC_CHANNELS; ch++)
+  {
+    adc_acc[ch].state = ADC_IDLE;
+    adc_pulses[ch].seq = 0;
+    adc_pulses[ch].samples = 0;
+  }
+  _io_ports[M6811_TMSK1] &= ~M6811_OC5I;
+  _io_ports[M6811_TCTL1] &= ~(M6811_OM5 | M6811_OL5);
+  _io_ports[M6811_OPTION] |= M6811_ADPU;
+  _io_ports[M6811_ADCTL] = M6811_SCAN | M6811_MULT;
+  restore(mask);
+}
+
+// Output compare 5 interrupt handler: take one sample of every channel
+// with its coil on.
+void __attribute__((interrupt)) adc_interrupt(void)
+{
+  struct adc_acc *a;
+  unsigned char ch, i, v, pins, active;
+
+  SCHED_WAKE();
+  _io_ports[M6811_TFLG1] = M6811_OC5F;
+  set_output_compare_5(get_output_compare_5() + ADC_SAMPLE_TICKS);
+
+  v = _io_ports[M6811_ADR1 + ADC_SUPPLY];
+  active = 0;
+  for(ch = 0, a = adc_acc; ch < ADC_CHANNELS; ch++, a++)
+  {
+    if(a->state != ADC_WAIT && a->state != ADC_ON)
+      continue;
+
+    pins = pulse_pins[ch].open | pulse_pins[ch].close;
+    if(_io_ports[pulse_pins[ch].port] & pins)
+    {
+      i = _io_ports[M6811_ADR1 + ch];
+      a->state = ADC_ON;
+      a->samples++;
+      a->sum_i += i;
+      a->sum_v += v;
+      a->sum_p += (unsigned short) i * (unsigned short) v;
+      if(i > a->peak)
+        a->peak = i;
+      active = 1;
+    }
+    else if(a->state == ADC_ON)
+    {
+      a->state = ADC_READY;
+      sched_post(SCHED_EV_PULSE);
+    }
+    else if(pulse_busy(ch))
+      active = 1;
+    else
+      a->state = ADC_IDLE;
+  }
+
+  if(!active)
+    _io_ports[M6811_TMSK1] &= ~M6811_OC5I;
+}
+
+// Watch the pulse just asked for on a channel.
+void adc_start(unsigned char ch, unsigned char direction)
+{
+  struct adc_acc *a;
+  unsigned short mask;
+
+  if(ch >= ADC_CHANNELS)
+    return;
+
+  a = &adc_acc[ch];
+  mask = lock();
+  a->direction = direction;
+  a->peak = 0;
+  a->samples = 0;
+  a->sum_i = 0;
+  a->sum_v = 0;
+  a->sum_p = 0;
+  a->state = ADC_WAIT;
+  if(!(_io_ports[M6811_TMSK1] & M6811_OC5I))
+  {
+    set_output_compare_5(get_timer_counter() + ADC_SAMPLE_TICKS);
+    _io_ports[M6811_TFLG1] = M6811_OC5F;
+    _io_ports[M6811_TMSK1] |= M6811_OC5I;
+  }
+  restore(mask);
+}
+
+// Make the record of every pulse that ended.  Runs on every tick and
+// whenever a pulse ends.
+void adc_task(void)
+{
+  struct adc_acc *a;
+  adc_pulse_t *r;
+  unsigned short n;
+  unsigned char ch;
+
+  for(ch = 0, a = adc_acc, r = adc_pulses; ch < ADC_CHANNELS; ch++, a++, r++)
+  {
+    if(a->state != ADC_READY)
+      continue;
+
+    // The handler leaves a ready channel alone, so no lock is needed.
+    n = a->samples;
+    r->direction = a->direction;
+    r->samples = n;
+    r->peak_ma = (unsigned short) ((a->peak * ADC_I_FULL_MA) >> 8);
+    r->mean_ma = (unsigned short) (((a->sum_i * 16) / n * ADC_I_FULL_MA) >> 12);
+    r->supply_mv = (unsigned short) (((a->sum_v * 16) / n * ADC_V_FULL_MV) >> 12);
+    r->energy_mj = (a->sum_p / 1000) * ADC_NJ_PER_COUNT2 / 1000;
+    r->seq++;
+    a->state = ADC_IDLE;
+  }
+}
@@ -0,0 +1,59 @@
+/*  Filename:       adc.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the coil current monitor.
+    The A/D converter scans PE0..PE3 continuously: the current sense of
+    bridges 0 to 2 and the supply voltage.  While a coil is on it is
+    sampled every ADC_SAMPLE_TICKS, and once the pulse is over its peak
+    and mean current, mean supply voltage and energy make one record.
+    Bridge 3 has no current sense.
+*/
+
+#ifndef _ADC_H
+#define _ADC_H
+
+/* Bridges with a current sense, on PE0 onwards.  */
+#define ADC_CHANNELS        3
+
+/* Supply voltage input (PE3), read from ADR4.  */
+#define ADC_SUPPLY          3
+
+/* Full scale (a count of 256) of the current sense (1V/A into the 5V
+   reference) and of the supply voltage (1:5 divider).  */
+#define ADC_I_FULL_MA       5000L
+#define ADC_V_FULL_MV       25000L
+
+/* Sample period, in TCNT ticks (1.024ms): five samples in the L/R time
+   of a coil, and a sample costs about 150us.  */
+#define ADC_SAMPLE_TICKS    128
+#define ADC_SAMPLE_US       (ADC_SAMPLE_TICKS * TB_US_PER_TICK)
+
+/* Energy of one sample, in nJ, for a current count times a voltage
+   count of 1.  */
+#define ADC_NJ_PER_COUNT2   (ADC_I_FULL_MA * (ADC_V_FULL_MV / 1000L) \
+                             * ADC_SAMPLE_US / 65536L)
+
+/*! Last pulse of a channel.  */
+struct adc_pulse
+{
+  unsigned char seq;                    /* + 1 for each record */
+  unsigned char direction;              /* PULSE_OPEN or PULSE_CLOSE */
+  unsigned short samples;
+  unsigned short peak_ma;
+  unsigned short mean_ma;
+  unsigned short supply_mv;             /* mean while the coil was on */
+  unsigned long energy_mj;
+};
+typedef struct adc_pulse adc_pulse_t;
+
+extern adc_pulse_t adc_pulses[ADC_CHANNELS];
+
+extern void adc_interrupt (void) __attribute__((interrupt));
+
+extern void adc_init (void);
+extern void adc_start (unsigned char ch, unsigned char direction);
+extern void adc_task (void);
+
+#endif
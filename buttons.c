@@ -0,0 +1,161 @@
+/*  Filename:       buttons.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Debounced button input.  buttons_sample runs from the
+    RTI interrupt.  Each input bit has a 2-bit counter spread over two
+    bytes (a vertical counter), so all the buttons are debounced at once
+    with a few logic operations: a bit of the debounced state flips only
+    after four consecutive samples disagree with it (about 16ms).
+
+    Edges of the debounced state and hold timers produce events in a
+    small queue read by the foreground with buttons_get, so a press is
+    seen exactly once however long the button stays down.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "buttons.h"
+
+#define BUTTON_QUEUE_MASK (BUTTON_QUEUE_SIZE - 1)
+
+// Debounced state and the two counter bits of every input.
+static unsigned char button_state;
+static unsigned char button_cnt0;
+static unsigned char button_cnt1;
+
+// Ticks until the next hold or repeat event of each button, and the
+// buttons that already sent their hold event.
+static unsigned short button_timer[BUTTON_COUNT];
+static unsigned char button_held;
+
+// TCNT at the sample where each button input last started to differ
+// from the debounced state.
+static unsigned short button_edge[BUTTON_COUNT];
+
+static unsigned char button_queue[BUTTON_QUEUE_SIZE];
+static volatile unsigned char button_head;
+static volatile unsigned char button_tail;
+
+// Queue an event; it is lost if the queue is full.
+static void button_post(unsigned char event)
+{
+  unsigned char head, next;
+
+  head = button_head;
+  next = (head + 1) & BUTTON_QUEUE_MASK;
+  if(next == button_tail)
+    return;
+
+  button_queue[head] = event;
+  button_head = next;
+  sched_post(SCHED_EV_BUTTON);
+}
+
+void buttons_init(void)
+{
+  unsigned char i;
+
+  button_state = 0;
+  button_cnt0 = 0;
+  button_cnt1 = 0;
+  button_held = 0;
+  button_head = 0;
+  button_tail = 0;
+  for(i = 0; i < BUTTON_COUNT; i++)
+  {
+    button_timer[i] = 0;
+    button_edge[i] = 0;
+  }
+}
+
+// Sample the buttons.  Called from the RTI interrupt.
+void buttons_sample(void)
+{
+  unsigned char delta, start, toggle, active, bit, i;
+  unsigned short now;
+
+  delta = ((_io_ports[M6811_PORTA] & BUTTON_MASK_A)
+           | (_io_ports[M6811_PORTE] & BUTTON_MASK_E)) ^ button_state;
+
+  // A disagreeing bit whose counter is still at zero is a new edge.
+  start = delta & ~(button_cnt0 | button_cnt1);
+  if(start)
+  {
+    now = get_timer_counter();
+    for(i = 0, bit = 1; i < BUTTON_COUNT; i++, bit <<= 1)
+      if(start & bit)
+        button_edge[i] = now;
+  }
+
+  // Count the samples that disagree with the state; the counter of a
+  // bit that agrees is held at zero.
+  button_cnt1 = (button_cnt1 ^ button_cnt0) & delta;
+  button_cnt0 = ~button_cnt0 & delta;
+  toggle = delta & ~(button_cnt0 | button_cnt1);
+  button_state ^= toggle;
+
+  // Only the buttons that are down or just changed have work to do.
+  active = toggle | button_state;
+  for(i = 0, bit = 1; active; i++, bit <<= 1)
+  {
+    if(!(active & bit))
+      continue;
+    active &= ~bit;
+
+    if(toggle & bit)
+    {
+      if(button_state & bit)
+      {
+        button_post(BUTTON_PRESS | i);
+        button_timer[i] = BUTTON_HOLD_TICKS;
+        button_held &= ~bit;
+      }
+      else
+      {
+        button_post(BUTTON_RELEASE | i);
+      }
+    }
+    else if((button_state & bit) && --button_timer[i] == 0)
+    {
+      // Still down: the first expiry is a hold, the next ones repeats.
+      if(button_held & bit)
+      {
+        button_post(BUTTON_REPEAT | i);
+      }
+      else
+      {
+        button_post(BUTTON_HOLD | i);
+        button_held |= bit;
+      }
+      button_timer[i] = BUTTON_REPEAT_TICKS;
+    }
+  }
+}
+
+// Fetch the next event.  Returns 0 if there is none.
+unsigned char buttons_get(void)
+{
+  unsigned char tail, event;
+
+  tail = button_tail;
+  if(tail == button_head)
+    return 0;
+
+  event = button_queue[tail];
+  button_tail = (tail + 1) & BUTTON_QUEUE_MASK;
+  return event;
+}
+
+// TCNT value of the sample that first saw the last change of a button.
+unsigned short buttons_edge(unsigned char button)
+{
+  return button_edge[button];
+}
+
+// Debounced state of the buttons, bit n for button n.
+unsigned char buttons_state(void)
+{
+  return button_state;
+}
@@ -0,0 +1,54 @@
+/*  Filename:       buttons.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the button input engine.
+    PA0..PA2 and PE4..PE7 are sampled from the RTI interrupt, debounced
+    with vertical counters, and turned into press, release, hold and
+    repeat events.  With the end-of-travel sensors (sense.h) PA0 and PA1
+    are sensor inputs and are left out.
+*/
+
+#ifndef _BUTTONS_H
+#define _BUTTONS_H
+
+/* Buttons.  Button n is bit n of the inputs sampled together from
+   Port A (bits 0 to 2) and Port E (bits 4 to 7).  */
+#define BUTTON_OPEN     0               /* PA0 */
+#define BUTTON_CLOSE    1               /* PA1 */
+#define BUTTON_CLEAR    2               /* PA2 */
+#define BUTTON_OPEN1    4               /* PE4 */
+#define BUTTON_CLOSE1   5               /* PE5 */
+#define BUTTON_OPEN2    6               /* PE6 */
+#define BUTTON_CLOSE2   7               /* PE7 */
+#define BUTTON_COUNT    8
+#ifdef SENSE_ENABLE
+#define BUTTON_MASK_A   (PA2)
+#else
+#define BUTTON_MASK_A   (PA0 | PA1 | PA2)
+#endif
+#define BUTTON_MASK_E   (PE4 | PE5 | PE6 | PE7)
+
+/* An event is the event type ORed with the button number.  */
+#define BUTTON_PRESS    0x10
+#define BUTTON_RELEASE  0x20
+#define BUTTON_HOLD     0x30            /* held for BUTTON_HOLD_TICKS */
+#define BUTTON_REPEAT   0x40            /* every BUTTON_REPEAT_TICKS after */
+#define BUTTON_TYPE(EV) ((EV) & 0xF0)
+#define BUTTON_NUM(EV)  ((EV) & 0x0F)
+
+/* Hold and repeat delays, in RTI ticks.  */
+#define BUTTON_HOLD_TICKS   ((unsigned short) (TIMER_TICK))         /* 1s */
+#define BUTTON_REPEAT_TICKS ((unsigned short) (TIMER_TICK / 4))     /* 250ms */
+
+/* Event queue size (must be a power of 2).  */
+#define BUTTON_QUEUE_SIZE   8
+
+extern void buttons_init (void);
+extern void buttons_sample (void);
+extern unsigned char buttons_get (void);
+extern unsigned char buttons_state (void);
+extern unsigned short buttons_edge (unsigned char button);
+
+#endif
@@ -0,0 +1,129 @@
+/*  Filename:       eeprom.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    On-chip EEPROM writer.
+
+    A byte that already holds the new value is left alone.  Programming
+    can only clear bits, so a byte is erased (to 0xFF) first only when
+    the new value needs a bit set, and not programmed after the erase
+    when the new value is 0xFF.  That saves time as well as wear.
+
+    Both sequences latch the address and data with EELAT, then turn on
+    the programming voltage with EEPGM.  The EEPROM cannot be read while
+    EELAT is set, so nothing may read _eeprom while eeprom_busy.  The
+    block to write is not copied: the caller keeps it unchanged until
+    the write is over.
+*/
+
+#include "ShutterJig.h"
+#include "eeprom.h"
+
+#define EE_IDLE     0
+#define EE_ERASE    1
+#define EE_PROGRAM  2
+
+#define EE_PROG_TCNT  ((EE_PROG_US * (TCNT_RATE / 1000L)) / 1000L)
+
+unsigned short eeprom_programs;
+unsigned short eeprom_erases;
+
+static const unsigned char *ee_src;
+static unsigned short ee_dst;
+static unsigned char ee_len;
+static unsigned char ee_pos;
+static unsigned char ee_step;
+
+// TCNT time at which the programming voltage was turned on.
+static unsigned long ee_start;
+
+void eeprom_init(void)
+{
+  _io_ports[M6811_PPROG] = 0;
+  ee_len = 0;
+  ee_pos = 0;
+  ee_step = EE_IDLE;
+  eeprom_programs = 0;
+  eeprom_erases = 0;
+}
+
+// Latch one byte for the step and turn on the programming voltage.
+static void eeprom_start(unsigned char step, unsigned char val)
+{
+  unsigned char pprog;
+
+  pprog = step == EE_ERASE ? M6811_BYTE | M6811_ERASE | M6811_EELAT
+                           : M6811_EELAT;
+  _io_ports[M6811_PPROG] = pprog;
+  _eeprom[ee_dst + ee_pos] = val;
+  _io_ports[M6811_PPROG] = pprog | M6811_EEPGM;
+  ee_start = timebase_now();
+  ee_step = step;
+}
+
+// Start writing len bytes at offset.  Returns 0 if a write is still in
+// progress.
+unsigned char eeprom_write(unsigned short offset, const unsigned char *data,
+                           unsigned char len)
+{
+  if(eeprom_busy())
+    return 0;
+
+  ee_src = data;
+  ee_dst = offset;
+  ee_pos = 0;
+  ee_len = len;
+  eeprom_poll();
+  return 1;
+}
+
+// Return != 0 while a write is in progress.
+unsigned char eeprom_busy(void)
+{
+  return ee_pos < ee_len;
+}
+
+// Move the write along: end the current step when its time is up, then
+// start the next one.  Called on every tick.
+void eeprom_poll(void)
+{
+  unsigned char old, val;
+
+  if(ee_step != EE_IDLE)
+  {
+    if(timebase_now() - ee_start < EE_PROG_TCNT)
+      return;
+    _io_ports[M6811_PPROG] = 0;
+
+    if(ee_step == EE_ERASE)
+    {
+      eeprom_erases++;
+      if(ee_src[ee_pos] != 0xFF)
+      {
+        eeprom_start(EE_PROGRAM, ee_src[ee_pos]);
+        return;
+      }
+    }
+    else
+    {
+      eeprom_programs++;
+    }
+    ee_step = EE_IDLE;
+    ee_pos++;
+  }
+
+  for(; ee_pos < ee_len; ee_pos++)
+  {
+    old = _eeprom[ee_dst + ee_pos];
+    val = ee_src[ee_pos];
+    if(old == val)
+      continue;
+
+    if((old & val) != val)
+      eeprom_start(EE_ERASE, 0xFF);
+    else
+      eeprom_start(EE_PROGRAM, val);
+    return;
+  }
+}
@@ -0,0 +1,40 @@
+/*  Filename:       eeprom.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the on-chip EEPROM writer.
+    A block is copied into the EEPROM one byte at a time with the PPROG
+    erase and program sequences.  Each step takes about 10ms, so the
+    writer never waits: eeprom_poll starts a step, and finishes it on a
+    later call once the time is up.
+*/
+
+#ifndef _EEPROM_H
+#define _EEPROM_H
+
+/* The EEPROM, at 0xB600 (see memory.x).  */
+#define EE_SIZE         512
+
+extern volatile unsigned char _eeprom[EE_SIZE];
+
+/* Block protect register of the MC68HC11E9.  It comes out of reset
+   with every EEPROM block protected, and can only be written in the
+   first 64 E clocks, so _start clears it.  */
+#define M6811_BPROT     0x35
+
+/* Programming or erase time of one byte, in microseconds.  */
+#define EE_PROG_US      10000L
+
+/* Number of bytes programmed and erased since reset.  */
+extern unsigned short eeprom_programs;
+extern unsigned short eeprom_erases;
+
+extern void eeprom_init (void);
+extern unsigned char eeprom_write (unsigned short offset,
+                                   const unsigned char *data,
+                                   unsigned char len);
+extern unsigned char eeprom_busy (void);
+extern void eeprom_poll (void);
+
+#endif
@@ -0,0 +1,187 @@
+/*  Filename:       endurance.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Endurance cycling mode.
+
+    A command is only given to a channel that is at rest with nothing
+    queued, so the pulse and dead times are the shortest a cycle can be;
+    a cycle period, when set, only spaces the commands further apart.
+    Half the period goes from the open command to the close command and
+    half from the close command to the next open one.  A cycle counts
+    when the shutter gets back to CLOSED after a close command, so a run
+    stopped part way does not count its last open.
+
+    The task runs after the shutter task, on every tick and whenever a
+    pulse ends.  It shows the channel last started on LCD line 1, with
+    the cycles completed and the mean rate since the start.
+*/
+
+#include "ShutterJig.h"
+#include "format.h"
+#include "shutter.h"
+#include "endurance.h"
+
+endurance_t endurance[SHUTTER_CHANNELS];
+
+// Channel shown on the LCD.
+static unsigned char endure_shown;
+
+static const char * const endure_status_names[] =
+{
+  "run", "stop", "done", "fault"
+};
+
+// Show a channel on LCD line 1, as "E1 1234 56/m run".
+static void endurance_show(unsigned char ch)
+{
+  char line[33];                      // "E1 4294967295 4294967295/m fault"
+  char *p;
+
+  p = fmt_str(line, "E");
+  *p++ = '1' + ch;
+  p = fmt_str(p, " ");
+  p = fmt_u32(p, endurance[ch].cycles);
+  p = fmt_str(p, " ");
+  p = fmt_u32(p, endurance_rate(ch));
+  p = fmt_str(p, "/m ");
+  fmt_str(p, endure_status_names[endurance[ch].status]);
+  LCD_WriteLine(0, line);             // lcd line 1
+}
+
+static void endurance_end(unsigned char ch, unsigned char status)
+{
+  tb_clock_t clock;
+
+  timebase_clock(&clock);
+  endurance[ch].end_sec = clock.seconds;
+  endurance[ch].status = status;
+  endurance_show(ch);
+}
+
+void endurance_init(void)
+{
+  endurance_t *e;
+
+  for(e = endurance; e < endurance + SHUTTER_CHANNELS; e++)
+  {
+    e->status = ENDURE_STOPPED;
+    e->closing = 0;
+    e->cycles = 0;
+    e->total = 0;
+    e->start_sec = 0;
+    e->end_sec = 0;
+  }
+  endure_shown = 0;
+}
+
+// Start cycling a channel for target cycles (0: until stopped), one
+// cycle every period_ms at most.  Starting clears the fault bits of the
+// channel, so a run can be resumed once the fault is dealt with.
+// Returns 0 if the period is out of range.
+unsigned char endurance_start(unsigned char ch, unsigned long target,
+                              unsigned long period_ms)
+{
+  endurance_t *e;
+  tb_clock_t clock;
+
+  if(period_ms > ENDURE_MAX_MS)
+    return 0;
+
+  e = &endurance[ch];
+  shutters[ch].fault = 0;
+  e->closing = 0;
+  e->cycles = 0;
+  e->target = target;
+  e->half_ticks = (period_ms * 1000L / TB_RTI_US) / 2;
+  timebase_clock(&clock);
+  e->start_sec = clock.seconds;
+  e->next_tick = clock.ticks;
+  e->status = ENDURE_RUNNING;
+  endure_shown = ch;
+  endurance_show(ch);
+  return 1;
+}
+
+// Stop cycling a channel.  A pulse in progress runs to its end.
+void endurance_stop(unsigned char ch)
+{
+  if(endurance[ch].status == ENDURE_RUNNING)
+    endurance_end(ch, ENDURE_STOPPED);
+}
+
+// Mean cycles per minute since the start of the current or last run, to
+// the whole second.  This takes 32-bit divides, so it is for the display
+// only.  The whole cycles per second are scaled apart from the rest, so
+// no product goes past 32 bits however long the run.
+unsigned long endurance_rate(unsigned char ch)
+{
+  tb_clock_t clock;
+  unsigned long seconds, cycles;
+
+  if(endurance[ch].status == ENDURE_RUNNING)
+  {
+    timebase_clock(&clock);
+    seconds = clock.seconds;
+  }
+  else
+  {
+    seconds = endurance[ch].end_sec;
+  }
+  seconds -= endurance[ch].start_sec;
+  if(seconds == 0)
+    return 0;
+  cycles = endurance[ch].cycles;
+  return cycles / seconds * 60 + cycles % seconds * 60 / seconds;
+}
+
+// Give the next command of every running channel that is ready for it.
+void endurance_task(void)
+{
+  endurance_t *e;
+  unsigned long now;
+  unsigned char ch;
+
+  now = timebase_ticks();
+  for(ch = 0, e = endurance; ch < SHUTTER_CHANNELS; ch++, e++)
+  {
+    if(e->status != ENDURE_RUNNING)
+      continue;
+
+    if(shutters[ch].fault)
+    {
+      endurance_end(ch, ENDURE_FAULT);
+      continue;
+    }
+    if(!shutter_ready(ch))
+      continue;
+
+    if(e->closing && shutters[ch].state == SHUTTER_CLOSED)
+    {
+      e->closing = 0;
+      e->cycles++;
+      e->total++;
+      if(e->target && e->cycles >= e->target)
+      {
+        endurance_end(ch, ENDURE_DONE);
+        continue;
+      }
+      if(ch == endure_shown)
+        endurance_show(ch);
+    }
+
+    if((long) (now - e->next_tick) < 0)
+      continue;
+    e->next_tick = now + e->half_ticks;
+    if(shutters[ch].state == SHUTTER_OPENED)
+    {
+      e->closing = 1;
+      shutter_command(ch, SHUTTER_CMD_CLOSE);
+    }
+    else
+    {
+      shutter_command(ch, SHUTTER_CMD_OPEN);
+    }
+  }
+}
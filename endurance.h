@@ -0,0 +1,49 @@
+/*  Filename:       endurance.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the endurance cycling mode.
+    A channel in endurance mode is opened and closed over and over with
+    no one at the buttons, at a set cycle period or as fast as its pulse
+    and dead times allow, until a target number of cycles is reached, a
+    fault shows up or it is stopped.
+*/
+
+#ifndef _ENDURANCE_H
+#define _ENDURANCE_H
+
+/* Why a run ended.  */
+#define ENDURE_RUNNING  0
+#define ENDURE_STOPPED  1               /* stopped by a command */
+#define ENDURE_DONE     2               /* target count reached */
+#define ENDURE_FAULT    3               /* the shutter reported a fault */
+
+/* Longest cycle period, in milliseconds.  */
+#define ENDURE_MAX_MS   600000L
+
+/*! Endurance run of one channel.  */
+struct endurance
+{
+  unsigned char status;                 /* ENDURE_* */
+  unsigned char closing;                /* close given, cycle ends at CLOSED */
+  unsigned long cycles;                 /* cycles completed in this run */
+  unsigned long total;                  /* lifetime cycles, see persist.c */
+  unsigned long target;                 /* cycles to run (0: no limit) */
+  unsigned long half_ticks;             /* RTI ticks from command to command */
+  unsigned long start_sec;              /* clock seconds at the start */
+  unsigned long end_sec;                /* and at the end */
+  unsigned long next_tick;              /* earliest tick for the next command */
+};
+typedef struct endurance endurance_t;
+
+extern endurance_t endurance[SHUTTER_CHANNELS];
+
+extern void endurance_init (void);
+extern unsigned char endurance_start (unsigned char ch, unsigned long target,
+                                      unsigned long period_ms);
+extern void endurance_stop (unsigned char ch);
+extern unsigned long endurance_rate (unsigned char ch);
+extern void endurance_task (void);
+
+#endif
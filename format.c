@@ -0,0 +1,170 @@
+/*  Filename:       format.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Number formatting without sprintf.  The HC11 has no
+    32-bit divide, so every '/' or '%' on a long turns into a libgcc call
+    costing hundreds of cycles.  These routines find each digit by
+    subtracting the place value from a table until it no longer fits,
+    which needs at most nine compare/subtract steps per digit.
+*/
+
+#include "format.h"
+
+static const unsigned short fmt_pow10_16[] =
+{
+  10000, 1000, 100, 10
+};
+
+static const unsigned long fmt_pow10_32[] =
+{
+  1000000000L, 100000000L, 10000000L, 1000000L, 100000L, 10000L
+};
+
+// Place values of HH:MM:SS, in seconds, and the separator that
+// follows each digit.
+static const unsigned short fmt_hms_place[] =
+{
+  36000, 3600, 600, 60, 10, 1
+};
+
+static const char fmt_hms_sep[] =
+{
+  0, ':', 0, ':', 0, 0
+};
+
+#define SECONDS_PER_DAY (86400UL)
+
+static const char fmt_hex_digits[] = "0123456789ABCDEF";
+
+// Copy a string.
+char *fmt_str(char *p, const char *s)
+{
+  while(*s)
+    *p++ = *s++;
+  *p = 0;
+  return p;
+}
+
+// Emit the decimal digits of val from the power of ten pw down,
+// suppressing leading zeros unless started is set.
+static char *fmt_digits16(char *p, unsigned short val,
+                          const unsigned short *pw, unsigned char started)
+{
+  char c;
+
+  for(; pw < &fmt_pow10_16[sizeof(fmt_pow10_16) / sizeof(fmt_pow10_16[0])]; pw++)
+  {
+    c = '0';
+    while(val >= *pw)
+    {
+      val -= *pw;
+      c++;
+    }
+    if(c != '0' || started)
+    {
+      *p++ = c;
+      started = 1;
+    }
+  }
+  *p++ = '0' + (char) val;
+  *p = 0;
+  return p;
+}
+
+// Unsigned 16-bit decimal.
+char *fmt_u16(char *p, unsigned short val)
+{
+  return fmt_digits16(p, val, fmt_pow10_16, 0);
+}
+
+// Unsigned 32-bit decimal.  Only the top six digits need 32-bit
+// arithmetic; what is left below 10000 is finished in 16 bits.
+char *fmt_u32(char *p, unsigned long val)
+{
+  const unsigned long *pw;
+  unsigned char started = 0;
+  char c;
+
+  if(val < 65536L)
+    return fmt_digits16(p, (unsigned short) val, fmt_pow10_16, 0);
+
+  for(pw = fmt_pow10_32; pw < &fmt_pow10_32[sizeof(fmt_pow10_32) / sizeof(fmt_pow10_32[0])]; pw++)
+  {
+    c = '0';
+    while(val >= *pw)
+    {
+      val -= *pw;
+      c++;
+    }
+    if(c != '0' || started)
+    {
+      *p++ = c;
+      started = 1;
+    }
+  }
+
+  // A value this large always has started by now.
+  return fmt_digits16(p, (unsigned short) val, &fmt_pow10_16[1], 1);
+}
+
+// Zero padded HH:MM:SS of a number of seconds, wrapped to a day.
+char *fmt_hms(char *p, unsigned long seconds)
+{
+  unsigned long day;
+  unsigned short rest;
+  unsigned char i;
+  char c;
+
+  // Bring the value below one day by subtracting shifted copies of it.
+  day = SECONDS_PER_DAY << 15;
+  for(i = 0; i < 16; i++)
+  {
+    if(seconds >= day)
+      seconds -= day;
+    day >>= 1;
+  }
+
+  // A day does not fit in 16 bits, so the tens of hours are taken off
+  // in 32 bits and the rest is done in 16 bits.
+  c = '0';
+  while(seconds >= fmt_hms_place[0])
+  {
+    seconds -= fmt_hms_place[0];
+    c++;
+  }
+  *p++ = c;
+
+  rest = (unsigned short) seconds;
+  for(i = 1; i < sizeof(fmt_hms_place) / sizeof(fmt_hms_place[0]); i++)
+  {
+    c = '0';
+    while(rest >= fmt_hms_place[i])
+    {
+      rest -= fmt_hms_place[i];
+      c++;
+    }
+    *p++ = c;
+    if(fmt_hms_sep[i])
+      *p++ = fmt_hms_sep[i];
+  }
+  *p = 0;
+  return p;
+}
+
+// Two hex digits.
+char *fmt_hex8(char *p, unsigned char val)
+{
+  *p++ = fmt_hex_digits[val >> 4];
+  *p++ = fmt_hex_digits[val & 0x0F];
+  *p = 0;
+  return p;
+}
+
+// Four hex digits.
+char *fmt_hex16(char *p, unsigned short val)
+{
+  p = fmt_hex8(p, (unsigned char) (val >> 8));
+  return fmt_hex8(p, (unsigned char) val);
+}
@@ -0,0 +1,26 @@
+/*  Filename:       format.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the small number formatting
+    routines used on the display paths instead of sprintf.
+*/
+
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+/* Each routine writes at p, terminates the string with a 0 and
+   returns a pointer to that terminator, so calls can be chained:
+
+     p = fmt_str(buf, "t=");
+     p = fmt_u32(p, count);
+*/
+extern char *fmt_str (char *p, const char *s);
+extern char *fmt_u16 (char *p, unsigned short val);
+extern char *fmt_u32 (char *p, unsigned long val);
+extern char *fmt_hms (char *p, unsigned long seconds);
+extern char *fmt_hex8 (char *p, unsigned char val);
+extern char *fmt_hex16 (char *p, unsigned short val);
+
+#endif
@@ -0,0 +1,164 @@
+/*  Filename:       guard.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    H-bridge supervisor.
+
+    The pulse engine gives each pulse an allowance with guard_arm: the
+    number of checks its half may be seen on.  The check itself looks
+    only at the pins, so it catches a stuck compare, a pin left on by a
+    stray port write and a bridge driven both ways alike.  A half seen
+    on once its allowance is used up, or with none, trips the supervisor;
+    the allowance goes back to 0 as soon as the half is seen off.
+
+    A trip forces the Port A bridge pins low with OC1 (OC1M and OC1D)
+    and FOC1 in CFORC, so they go off at once whatever their own compare
+    is doing, then pulse_init turns off the Port D ones and leaves the
+    engine idle.  OC1M stays set until guard_clear, so every later
+    compare forces the pins low again.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "guard.h"
+
+guard_t guard;
+
+// Checks each channel may still be seen on, and the channels seen on
+// since their pulse was armed (bit n for channel n).
+static unsigned short guard_left[PULSE_CHANNELS];
+static unsigned char guard_seen;
+
+// All the bridge pins on Port A and on Port D.
+static unsigned char guard_pa;
+static unsigned char guard_pd;
+
+// Start checking, with no fault latched and no pulse allowed.
+void guard_init(void)
+{
+  unsigned short mask;
+  unsigned char ch;
+
+  mask = lock();
+  guard.fault = GUARD_OK;
+  guard.channel = 0;
+  guard.faults = 0;
+  guard_pa = 0;
+  guard_pd = 0;
+  for(ch = 0; ch < PULSE_CHANNELS; ch++)
+  {
+    guard_left[ch] = 0;
+    if(pulse_pins[ch].port == M6811_PORTA)
+      guard_pa |= pulse_pins[ch].open | pulse_pins[ch].close;
+    else
+      guard_pd |= pulse_pins[ch].open | pulse_pins[ch].close;
+  }
+  guard_seen = 0;
+  _io_ports[M6811_OC1M] = 0;
+  _io_ports[M6811_OC1D] = 0;
+  set_output_compare_1(get_timer_counter() + GUARD_TICKS);
+  _io_ports[M6811_TFLG1] = M6811_OC1F;
+  _io_ports[M6811_TMSK1] |= M6811_OC1I;
+  restore(mask);
+}
+
+// Put every bridge in the safe idle state, and latch the fault if it
+// is the first one.
+static void guard_trip(unsigned char fault, unsigned char ch)
+{
+  unsigned char i;
+
+  _io_ports[M6811_OC1M] = GUARD_OC1_PINS;
+  _io_ports[M6811_CFORC] = M6811_FOC1;
+  pulse_init();
+
+  for(i = 0; i < PULSE_CHANNELS; i++)
+    guard_left[i] = 0;
+  guard_seen = 0;
+  if(guard.fault == GUARD_OK)
+  {
+    guard.fault = fault;
+    guard.channel = ch;
+  }
+  guard.faults++;
+  sched_post(SCHED_EV_PULSE);
+}
+
+// Output compare 1 interrupt handler: check the pins of every bridge.
+void __attribute__((interrupt)) guard_interrupt(void)
+{
+  unsigned char ch, bit, pins, on;
+
+  SCHED_WAKE();
+  _io_ports[M6811_TFLG1] = M6811_OC1F;
+  set_output_compare_1(get_output_compare_1() + GUARD_TICKS);
+
+  // Most of the time every pin is off and there is nothing to forget.
+  if(guard_seen == 0 && !(_io_ports[M6811_PORTA] & guard_pa)
+     && !(_io_ports[M6811_PORTD] & guard_pd))
+    return;
+
+  for(ch = 0, bit = 1; ch < PULSE_CHANNELS; ch++, bit <<= 1)
+  {
+    pins = pulse_pins[ch].open | pulse_pins[ch].close;
+    on = _io_ports[pulse_pins[ch].port] & pins;
+    if(on == pins)
+    {
+      guard_trip(GUARD_OVERLAP, ch);
+      return;
+    }
+
+    if(on)
+    {
+      if(guard_left[ch] == 0)
+      {
+        guard_trip(GUARD_ON_TIME, ch);
+        return;
+      }
+      guard_left[ch]--;
+      guard_seen |= bit;
+    }
+    else if(guard_seen & bit)
+    {
+      guard_left[ch] = 0;
+      guard_seen &= ~bit;
+    }
+  }
+}
+
+// Allow the pulse about to start on a channel.  Called by the pulse
+// engine with the channel idle.
+void guard_arm(unsigned char ch, unsigned long on_us)
+{
+  unsigned short mask, left;
+
+  if(on_us > PULSE_MAX_US)
+    on_us = PULSE_MAX_US;
+  left = (unsigned short) ((on_us + GUARD_SLACK_US) / GUARD_US);
+
+  mask = lock();
+  guard_left[ch] = left;
+  guard_seen &= ~(1 << ch);
+  restore(mask);
+}
+
+// Take back what is left of the allowance of a channel once its pulse
+// is over, so a pulse too short to be seen on leaves none behind.
+// Called by the pulse engine from its interrupts.
+void guard_idle(unsigned char ch)
+{
+  guard_left[ch] = 0;
+  guard_seen &= ~(1 << ch);
+}
+
+// Clear the latched fault, so the pulse engine takes pulses again.
+void guard_clear(void)
+{
+  unsigned short mask;
+
+  mask = lock();
+  _io_ports[M6811_OC1M] = 0;
+  guard.fault = GUARD_OK;
+  restore(mask);
+}
@@ -0,0 +1,59 @@
+/*  Filename:       guard.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the H-bridge supervisor.
+    Every GUARD_TICKS the output compare 1 interrupt reads the bridge
+    pins back from the ports, apart from the pulse engine, and trips if
+    both halves of a bridge are on, or if a half stays on longer than
+    the pulse it was given allows (or is on with no pulse at all).
+
+    Mutual exclusion is the job of the pulse engine, which never drives
+    both halves of a bridge; the supervisor only detects a violation
+    after the fact, up to one check period (2.048ms) late.
+
+    A trip puts every bridge in the safe idle state (both halves off),
+    latches the fault and counts it.  While the fault is latched the
+    pulse engine takes no pulse, and OC1 keeps forcing the Port A bridge
+    pins low on every compare.
+*/
+
+#ifndef _GUARD_H
+#define _GUARD_H
+
+/* Check period, in TCNT ticks (2.048ms).  */
+#define GUARD_TICKS         256
+#define GUARD_US            (GUARD_TICKS * TB_US_PER_TICK)
+
+/* Time a half may stay on beyond the on time of its pulse: the lead
+   and the rounding to RTI periods of the channels other than 0.  */
+#define GUARD_SLACK_US      10000L
+
+/* Port A bridge pins, forced low by OC1 (channels 0 and 3).  */
+#define GUARD_OC1_PINS      (M6811_OC1M4 | M6811_OC1M5 | M6811_OC1M6 | M6811_OC1M7)
+
+/* Fault codes.  */
+#define GUARD_OK            0
+#define GUARD_OVERLAP       1           /* both halves on */
+#define GUARD_ON_TIME       2           /* on for too long, or unasked */
+
+/*! State of the supervisor.  */
+struct guard
+{
+  volatile unsigned char fault;         /* first fault, until cleared */
+  volatile unsigned char channel;       /* its channel */
+  volatile unsigned short faults;       /* trips since reset */
+};
+typedef struct guard guard_t;
+
+extern guard_t guard;
+
+extern void guard_interrupt (void) __attribute__((interrupt));
+
+extern void guard_init (void);
+extern void guard_arm (unsigned char ch, unsigned long on_us);
+extern void guard_idle (unsigned char ch);
+extern void guard_clear (void);
+
+#endif
@@ -89,6 +89,18 @@ unlock (void)
   __asm__ __volatile__ ("cli");
 }
 
+/*! Unlock the processor and wait for an interrupt.
+    The processor stacks its registers and stops until an interrupt
+    is accepted (\b wai ).  Call it with interrupts locked, after
+    checking that there is nothing left to do.
+
+    @see lock, unlock  */
+static __inline__ void
+unlock_and_wait (void)
+{
+  __asm__ __volatile__ ("cli\n\twai");
+}
+
 /*! Restore the interrupt mask of the processor.
     The mask is assumed to be in the high part (bits 15..8)
     to avoid a \b tba instruction. 
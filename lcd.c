@@ -0,0 +1,240 @@
+/*  Filename:       lcd.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Interrupt-driven HD44780 LCD driver.  LCD_Command,
+    cprint and LCDprint only queue bytes in a RAM ring buffer.  The output
+    compare 2 interrupt drains the ring one byte per slot, skipping a slot
+    whenever the display reports busy, and switches itself off once the
+    ring is empty.
+
+    On top of the ring sits a shadow copy of the 4x20 display.  Writers
+    only touch the shadow.  LCD_Flush compares it with a second copy of
+    what was last sent and queues one cursor address command followed by
+    the changed characters for each span that differs.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "trace.h"
+
+#define LCD_RING_MASK   (LCD_RING_SIZE - 1)
+#define LCD_SLOT_TICKS  US_TO_TCNT(LCD_SLOT_US)
+
+// Ring entries carry the byte in the low part and the register select
+// in bit 8 (set for data, clear for a command).
+#define LCD_RS          0x100
+
+static unsigned short lcd_ring[LCD_RING_SIZE];
+static volatile unsigned char lcd_head;
+static volatile unsigned char lcd_tail;
+
+unsigned short lcd_overruns;
+
+// What the application wants displayed, and what was last sent.
+static char lcd_shadow[LCD_ROWS][LCD_COLS];
+static char lcd_panel[LCD_ROWS][LCD_COLS];
+
+// DDRAM address of the first character of each row.
+static const unsigned char lcd_row_addr[LCD_ROWS] =
+{
+  LINE_1, LINE_2, LINE_3, LINE_4
+};
+
+// Output compare 2 interrupt handler: move one byte to the display.
+void __attribute__((interrupt)) lcd_interrupt(void)
+{
+  unsigned char tail;
+  unsigned short entry;
+
+  SCHED_WAKE();
+  _io_ports[M6811_TFLG1] = M6811_OC2F;
+
+  tail = lcd_tail;
+  if(tail == lcd_head)
+  {
+    // Nothing left to send, stop the slot timer.
+    _io_ports[M6811_TMSK1] &= ~M6811_OC2I;
+    return;
+  }
+
+  set_output_compare_2(get_timer_counter() + LCD_SLOT_TICKS);
+
+  // Try again next slot if the display is still working.
+  if(LCD_CMD & LCD_BUSY)
+    return;
+
+  entry = lcd_ring[tail];
+  if(entry & LCD_RS)
+    LCD_DAT = (unsigned char) entry;
+  else
+    LCD_CMD = (unsigned char) entry;
+
+  lcd_tail = (tail + 1) & LCD_RING_MASK;
+}
+
+// Start the slot timer if it is not already running.
+static void lcd_kick(void)
+{
+  unsigned short mask;
+
+  mask = lock();
+  if(!(_io_ports[M6811_TMSK1] & M6811_OC2I))
+  {
+    set_output_compare_2(get_timer_counter() + LCD_SLOT_TICKS);
+    _io_ports[M6811_TFLG1] = M6811_OC2F;
+    _io_ports[M6811_TMSK1] |= M6811_OC2I;
+  }
+  restore(mask);
+}
+
+// Queue one ring entry; the entry is dropped if the ring is full.
+static void lcd_put(unsigned short entry)
+{
+  unsigned char head;
+  unsigned char next;
+
+  head = lcd_head;
+  next = (head + 1) & LCD_RING_MASK;
+  if(next == lcd_tail)
+  {
+    lcd_overruns++;
+    return;
+  }
+
+  lcd_ring[head] = entry;
+  lcd_head = next;
+}
+
+// Number of entries that can still be queued.
+unsigned char LCD_Free(void)
+{
+  return (lcd_tail - lcd_head - 1) & LCD_RING_MASK;
+}
+
+void LCD_Command(unsigned char cval)
+{
+  lcd_put(cval);
+  lcd_kick();
+}
+
+void LCD_Initialize(void)
+{
+  unsigned char row, col;
+
+  // RAM is not cleared at reset.
+  lcd_head = lcd_tail = 0;
+  lcd_overruns = 0;
+
+  // Initialize the LCD
+  LCD_Command(0x3C);                 // initialize command
+  LCD_Command(0x0C);                 // display on, cursor off
+  LCD_Command(0x06);
+  LCD_Command(0x01);                 // clear display
+
+  // The clear leaves blanks everywhere, so both copies start out blank.
+  for(row = 0; row < LCD_ROWS; row++)
+    for(col = 0; col < LCD_COLS; col++)
+    {
+      lcd_shadow[row][col] = ' ';
+      lcd_panel[row][col] = ' ';
+    }
+}
+
+// LCD Display Character
+void cprint(char dval)
+{
+  lcd_put(LCD_RS | (unsigned char) dval);
+  lcd_kick();
+}
+
+// LCD Display String
+void LCDprint(char *sptr)
+{
+  while(*sptr)
+  {
+    lcd_put(LCD_RS | (unsigned char) *sptr);
+    ++sptr;
+  }
+  lcd_kick();
+}
+
+// Write a string into the shadow at the given row and column.
+// Characters past the end of the row are ignored.
+void LCD_Write(unsigned char row, unsigned char col, const char *sptr)
+{
+  char *dst;
+
+  dst = &lcd_shadow[row][col];
+  while(*sptr && col < LCD_COLS)
+  {
+    *dst++ = *sptr++;
+    col++;
+  }
+}
+
+// Replace a whole row of the shadow, padding with blanks.
+void LCD_WriteLine(unsigned char row, const char *sptr)
+{
+  char *dst;
+  unsigned char col;
+
+  dst = lcd_shadow[row];
+  for(col = 0; col < LCD_COLS; col++)
+  {
+    if(*sptr)
+      *dst++ = *sptr++;
+    else
+      *dst++ = ' ';
+  }
+}
+
+// Send the parts of the shadow that differ from the panel.  A span
+// also swallows a single unchanged character between two changes, since
+// re-sending it costs the same as a new cursor address.  Spans that do
+// not fit in the ring are left dirty for the next call.
+void LCD_Flush(void)
+{
+  unsigned char row, col, end;
+  char *shadow, *panel;
+
+  TRACE(TRACE_FLUSH);
+  for(row = 0; row < LCD_ROWS; row++)
+  {
+    shadow = lcd_shadow[row];
+    panel = lcd_panel[row];
+
+    col = 0;
+    while(col < LCD_COLS)
+    {
+      if(shadow[col] == panel[col])
+      {
+        col++;
+        continue;
+      }
+
+      end = col + 1;
+      while(end < LCD_COLS
+            && (shadow[end] != panel[end]
+                || (end + 1 < LCD_COLS && shadow[end + 1] != panel[end + 1])))
+        end++;
+
+      if(end - col + 1 > LCD_Free())
+      {
+        lcd_kick();
+        TRACE(TRACE_FLUSH_END);
+        return;
+      }
+
+      lcd_put(lcd_row_addr[row] + col);
+      for(; col < end; col++)
+      {
+        lcd_put(LCD_RS | (unsigned char) shadow[col]);
+        panel[col] = shadow[col];
+      }
+    }
+  }
+  lcd_kick();
+  TRACE(TRACE_FLUSH_END);
+}
@@ -0,0 +1,59 @@
+/*  Filename:       lcd.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the interrupt-driven LCD
+    driver.  Commands and characters are queued in a RAM ring buffer and
+    written to the HD44780 one byte per output compare 2 slot, so the
+    main loop never waits on the busy flag.  Text is normally written
+    to a 4x20 shadow of the display; LCD_Flush only sends the spans that
+    differ from what is already on the glass.
+*/
+
+#ifndef _LCD_H
+#define _LCD_H
+
+#define LINE_1      0x80                /* beginning position of LCD line 1 */
+#define LINE_2      0xC0                /* beginning position of LCD line 2 */
+#define LINE_3      0x94                /* beginning position of LCD line 3 */
+#define LINE_4      0xD4                /* beginning position of LCD line 4 */
+
+/* The LCD registers are placed by memory.x (0xB5F0 and 0xB5F1).  */
+extern volatile unsigned char _gdm_lcd_cmd;
+extern volatile unsigned char _gdm_lcd_data;
+
+#define LCD_CMD     _gdm_lcd_cmd
+#define LCD_DAT     _gdm_lcd_data
+
+#define LCD_BUSY    0x80                /* busy flag in the status register */
+
+/* Geometry of the display.  */
+#define LCD_ROWS        4
+#define LCD_COLS        20
+
+/* Size of the command/data ring (must be a power of 2).  */
+#define LCD_RING_SIZE   64
+
+/* Time between two transfers to the display, in microseconds.
+   Most HD44780 operations complete in 40us; the slower ones
+   (clear, home) are covered by checking the busy flag.  */
+#define LCD_SLOT_US     100L
+
+extern void lcd_interrupt (void) __attribute__((interrupt));
+
+extern void LCD_Initialize (void);
+extern void LCD_Command (unsigned char cval);
+extern void cprint (char dval);
+extern void LCDprint (char *sptr);
+extern unsigned char LCD_Free (void);
+
+/* Shadow framebuffer access.  Rows are numbered 0 (LINE_1) to 3 (LINE_4).  */
+extern void LCD_Write (unsigned char row, unsigned char col, const char *sptr);
+extern void LCD_WriteLine (unsigned char row, const char *sptr);
+extern void LCD_Flush (void);
+
+/* Number of bytes dropped because the ring was full.  */
+extern unsigned short lcd_overruns;
+
+#endif
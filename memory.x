@@ -1,18 +1,26 @@
 /*  Filename:       memory.x
     Author:         Corey Davyduke
     Created:        2012-06-18
-    Modified:       2012-07-31
+    Modified:       2026-10-17
     Compiler:       GNU GCC
     Description:    This is the memory definition file for
                     the ShutterJig project.
 */
 
+/* The program no longer fits the 8K at 0xE000 it started in, so it takes
+   the 32K EPROM socket at 0x8000.  The LCD (0xB5F0) and the on-chip
+   EEPROM (0xB600) split the socket in two: text runs from 0xB800 up to
+   the vectors at 0xFFC0, and text_lo from 0x8000 up to the LCD.  The
+   Makefile shows the size after every link, and the link fails if
+   either part does not fit.  */
+
 MEMORY
 {
   page0 (rwx) : ORIGIN = 0x0, LENGTH = 0xFF
-  text  (rx)  : ORIGIN = 0xE000, LENGTH = 0x1FFF
+  text  (rx)  : ORIGIN = 0xB800, LENGTH = 0x47C0
+  text_lo (rx) : ORIGIN = 0x8000, LENGTH = 0x35F0
   data        : ORIGIN = 0x2000, LENGTH = 0x1FFF
-  eeprom (rx) : ORIGIN = 0xB600, LENGTH = 0x1FF
+  eeprom (rx) : ORIGIN = 0xB600, LENGTH = 0x200
 }
 
 /* Setup the stack on the top of the data memory bank.  */
@@ -21,3 +29,18 @@ PROVIDE (_stack = 0x3FFF);
 /* Setup the LCD access variables.  */
 PROVIDE (_gdm_lcd_cmd = 0xB5F0);
 PROVIDE (_gdm_lcd_data = 0xB5F1);
+
+/* The on-chip EEPROM, written through PPROG (see eeprom.c).  */
+PROVIDE (_eeprom = 0xB600);
+
+/* The code of the optional and the bench-side modules goes below the
+   LCD.  These names come before the default script's *(.text), so the
+   linker places them here first.  */
+SECTIONS
+{
+  .text_lo :
+  {
+    proto.o(.text) trace.o(.text) sense.o(.text) tune.o(.text)
+    adc.o(.text) guard.o(.text) endurance.o(.text) persist.o(.text)
+  } > text_lo
+}
@@ -0,0 +1,227 @@
+/*  Filename:       persist.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Settings and counts kept in the EEPROM.
+
+    Each save writes a whole record to the slot after the newest one, so
+    the writes go round all the slots in turn and every byte wears at
+    the same rate.  The committed record with the highest sequence
+    number (taken modulo 2^16) and a good CRC is the newest.
+
+    A save first erases the commit byte of its slot, then writes the
+    record in order with the commit byte last.  A save cut short by a
+    reset therefore leaves its slot uncommitted, whatever else it got
+    to, and the record before it is used.
+
+    The record is built in RAM and handed to the EEPROM writer, which
+    takes about 10ms per changed byte in the background.  New pulse
+    times are saved as soon as the writer is free.  A cycle count that
+    is still going up is only saved every PERSIST_COUNT_SECS (an hour),
+    and at once when no channel is running, which bounds the wear
+    during a long endurance run.
+*/
+
+#include "ShutterJig.h"
+#include "eeprom.h"
+#include "shutter.h"
+#include "endurance.h"
+#include "proto.h"
+#include "persist.h"
+
+unsigned short persist_commits;
+
+static unsigned short persist_seq;
+static unsigned char persist_slot;
+
+// Record being written (or last written), and != 0 while its commit
+// byte is being erased, before the record itself is written.
+static unsigned char persist_rec[PERSIST_LEN];
+static unsigned char persist_pending;
+
+static const unsigned char persist_erased = 0xFF;
+
+// What the last record holds, to tell when another one is needed.
+static unsigned long persist_on_us[SHUTTER_CHANNELS];
+static unsigned long persist_dead_us[SHUTTER_CHANNELS];
+static unsigned long persist_total[SHUTTER_CHANNELS];
+
+// Clock seconds of the last save.
+static unsigned long persist_sec;
+
+static void persist_put32(unsigned char *p, unsigned long val)
+{
+  p[0] = (unsigned char) (val >> 24);
+  p[1] = (unsigned char) (val >> 16);
+  p[2] = (unsigned char) (val >> 8);
+  p[3] = (unsigned char) val;
+}
+
+static unsigned long persist_get32(unsigned short offset)
+{
+  unsigned long val;
+  unsigned char i;
+
+  val = 0;
+  for(i = 0; i < 4; i++)
+    val = (val << 8) | _eeprom[offset + i];
+  return val;
+}
+
+// CRC of a record, up to its CRC byte.
+static unsigned char persist_crc(const volatile unsigned char *rec)
+{
+  unsigned char crc, i;
+
+  crc = 0;
+  for(i = 0; i < PERSIST_CRC; i++)
+    crc = proto_crc8(crc, rec[i]);
+  return crc;
+}
+
+// Check the record of a slot.  Returns != 0 if it is good.
+static unsigned char persist_check(unsigned char slot)
+{
+  const volatile unsigned char *rec;
+
+  rec = &_eeprom[slot * PERSIST_SLOT_SIZE];
+  return rec[PERSIST_COMMIT] == PERSIST_DONE
+         && rec[PERSIST_VER] == PERSIST_VERSION
+         && rec[PERSIST_CRC] == persist_crc(rec);
+}
+
+// Load the newest good record, if there is one, into the shutters and
+// the endurance counts.  Called at reset, after shutter_init and
+// endurance_init.  Returns 0 when no record was found.
+unsigned char persist_init(void)
+{
+  unsigned short base, seq;
+  unsigned long on_us, dead_us;
+  unsigned char slot, found, ch;
+
+  eeprom_init();
+  persist_commits = 0;
+  persist_pending = 0;
+  persist_sec = 0;
+
+  found = 0;
+  for(slot = 0; slot < PERSIST_SLOTS; slot++)
+  {
+    if(!persist_check(slot))
+      continue;
+    base = slot * PERSIST_SLOT_SIZE;
+    seq = (_eeprom[base + PERSIST_SEQ] << 8) | _eeprom[base + PERSIST_SEQ + 1];
+    if(!found || (short) (seq - persist_seq) > 0)
+    {
+      persist_seq = seq;
+      persist_slot = slot;
+      found = 1;
+    }
+  }
+
+  if(!found)
+  {
+    // The first save goes to slot 0.
+    persist_seq = 0;
+    persist_slot = PERSIST_SLOTS - 1;
+  }
+
+  base = persist_slot * PERSIST_SLOT_SIZE + PERSIST_CHANNEL;
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++, base += PERSIST_CH_SIZE)
+  {
+    if(found)
+    {
+      on_us = persist_get32(base);
+      dead_us = persist_get32(base + 4);
+      if(on_us >= PULSE_MIN_US && on_us <= PULSE_MAX_US
+         && dead_us >= PULSE_MIN_US && dead_us <= PULSE_MAX_US)
+      {
+        shutters[ch].on_us = on_us;
+        shutters[ch].dead_us = dead_us;
+      }
+      endurance[ch].total = persist_get32(base + 8);
+    }
+
+    // Only save again once something changes.
+    persist_on_us[ch] = shutters[ch].on_us;
+    persist_dead_us[ch] = shutters[ch].dead_us;
+    persist_total[ch] = endurance[ch].total;
+  }
+  return found;
+}
+
+// Build the next record and start erasing the commit byte of its slot;
+// persist_task writes the record once that is done.
+static void persist_commit(void)
+{
+  unsigned char *p;
+  unsigned char ch;
+
+  persist_seq++;
+  persist_slot = (persist_slot + 1) % PERSIST_SLOTS;
+
+  persist_rec[PERSIST_SEQ] = (unsigned char) (persist_seq >> 8);
+  persist_rec[PERSIST_SEQ + 1] = (unsigned char) persist_seq;
+  persist_rec[PERSIST_VER] = PERSIST_VERSION;
+  p = &persist_rec[PERSIST_CHANNEL];
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++, p += PERSIST_CH_SIZE)
+  {
+    persist_on_us[ch] = shutters[ch].on_us;
+    persist_dead_us[ch] = shutters[ch].dead_us;
+    persist_total[ch] = endurance[ch].total;
+    persist_put32(p, persist_on_us[ch]);
+    persist_put32(p + 4, persist_dead_us[ch]);
+    persist_put32(p + 8, persist_total[ch]);
+  }
+
+  persist_rec[PERSIST_CRC] = persist_crc(persist_rec);
+  persist_rec[PERSIST_COMMIT] = PERSIST_DONE;
+
+  eeprom_write(persist_slot * PERSIST_SLOT_SIZE + PERSIST_COMMIT,
+               &persist_erased, 1);
+  persist_pending = 1;
+  persist_commits++;
+}
+
+// Keep the EEPROM write going, and start a save when the settings or
+// counts have changed.  Runs on every tick.
+void persist_task(void)
+{
+  tb_clock_t clock;
+  unsigned char ch, settings, counts, running;
+
+  eeprom_poll();
+  if(eeprom_busy())
+    return;
+
+  if(persist_pending)
+  {
+    eeprom_write(persist_slot * PERSIST_SLOT_SIZE, persist_rec, PERSIST_LEN);
+    persist_pending = 0;
+    return;
+  }
+
+  settings = 0;
+  counts = 0;
+  running = 0;
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+  {
+    if(shutters[ch].on_us != persist_on_us[ch]
+       || shutters[ch].dead_us != persist_dead_us[ch])
+      settings = 1;
+    if(endurance[ch].total != persist_total[ch])
+      counts = 1;
+    if(endurance[ch].status == ENDURE_RUNNING)
+      running = 1;
+  }
+  if(!settings && !counts)
+    return;
+
+  timebase_clock(&clock);
+  if(!settings && running && clock.seconds - persist_sec < PERSIST_COUNT_SECS)
+    return;
+
+  persist_sec = clock.seconds;
+  persist_commit();
+}
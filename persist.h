@@ -0,0 +1,49 @@
+/*  Filename:       persist.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the settings and counts
+    kept in the EEPROM.  The pulse times and the lifetime cycle count of
+    each channel are saved as one record in a ring of slots, and the
+    newest good record is loaded at reset.
+*/
+
+#ifndef _PERSIST_H
+#define _PERSIST_H
+
+/* Size of a slot; the EEPROM holds EE_SIZE / PERSIST_SLOT_SIZE of them.  */
+#define PERSIST_SLOT_SIZE   64
+#define PERSIST_SLOTS       (EE_SIZE / PERSIST_SLOT_SIZE)
+
+/* Record layout, big-endian: sequence number, version, then the on
+   time, dead time and cycle count of each channel, the CRC-8 of all
+   that (as proto_crc8), and a commit byte, programmed last.  */
+#define PERSIST_VERSION     2
+#define PERSIST_SEQ         0
+#define PERSIST_VER         2
+#define PERSIST_CHANNEL     3
+#define PERSIST_CH_SIZE     12
+#define PERSIST_CRC         (PERSIST_CHANNEL + SHUTTER_CHANNELS * PERSIST_CH_SIZE)
+#define PERSIST_COMMIT      (PERSIST_CRC + 1)
+#define PERSIST_LEN         (PERSIST_COMMIT + 1)
+
+/* Commit byte of a whole record.  The byte is erased (0xFF) before the
+   rest of the slot is written, and a half programmed byte has some bits
+   still set.  */
+#define PERSIST_DONE        0x00
+
+/* While a channel runs, its cycle count is saved at most this often,
+   in seconds; it is saved at once when the run stops or faults.  With
+   the writes spread over PERSIST_SLOTS, a slot is written every 8 hours
+   of running, so the 10000 writes the EEPROM is rated for last about 9
+   years.  A reset during a run loses up to an hour of counts.  */
+#define PERSIST_COUNT_SECS  3600L
+
+/* Number of records saved since reset.  */
+extern unsigned short persist_commits;
+
+extern unsigned char persist_init (void);
+extern void persist_task (void);
+
+#endif
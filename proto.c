@@ -0,0 +1,387 @@
+/*  Filename:       proto.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Binary serial protocol.
+
+    The serial task hands each received byte to proto_rx before the line
+    editor, and the parser takes it one byte at a time, so a frame can
+    arrive in any number of pieces.  A frame that stops for longer than
+    PROTO_TIMEOUT_TICKS is dropped, so a lost byte cannot hold up the
+    line for good.
+
+    A reply is queued in one go, so it is never mixed up with the text
+    of the other tasks.  If the transmit ring has no room for it, it is
+    dropped and counted; the host asks again.
+*/
+
+#include "ShutterJig.h"
+#include "shutter.h"
+#include "stats.h"
+#include "endurance.h"
+#include "adc.h"
+#include "guard.h"
+#include "proto.h"
+
+#ifdef PROTO_ENABLE
+
+// A frame must be complete within 100ms.
+#define PROTO_TIMEOUT_TICKS ((unsigned short) (TIMER_TICK / 10))
+
+// Parser states.
+#define PROTO_HUNT      0
+#define PROTO_LEN       1
+#define PROTO_OP        2
+#define PROTO_DATA      3
+#define PROTO_CRC       4
+
+unsigned char proto_active;
+unsigned short proto_rx_errors;
+unsigned short proto_tx_drops;
+
+static unsigned char proto_state;
+static unsigned char proto_len;
+static unsigned char proto_op;
+static unsigned char proto_pos;
+static unsigned char proto_crc;
+static unsigned char proto_buf[PROTO_MAX_PAYLOAD];
+static unsigned short proto_last;
+
+// Telemetry period (0: off) and the tick of the next frame.
+static unsigned short proto_tel_ticks;
+static unsigned short proto_tel_next;
+
+// Sequence number of the last pulse record sent, for each channel.
+static unsigned char proto_pulse_seq[ADC_CHANNELS];
+
+void proto_init(void)
+{
+  proto_active = 0;
+  proto_rx_errors = 0;
+  proto_tx_drops = 0;
+  proto_state = PROTO_HUNT;
+  proto_tel_ticks = 0;
+}
+
+// Clear the error counts only; the link and the telemetry carry on.
+void proto_clear(void)
+{
+  proto_rx_errors = 0;
+  proto_tx_drops = 0;
+}
+
+static unsigned char *proto_put16(unsigned char *p, unsigned short val)
+{
+  *p++ = (unsigned char) (val >> 8);
+  *p++ = (unsigned char) val;
+  return p;
+}
+
+static unsigned char *proto_put32(unsigned char *p, unsigned long val)
+{
+  p = proto_put16(p, (unsigned short) (val >> 16));
+  return proto_put16(p, (unsigned short) val);
+}
+
+// Put the last pulse record of a channel.
+static unsigned char *proto_put_pulse(unsigned char *p, unsigned char ch)
+{
+  const adc_pulse_t *r;
+
+  r = &adc_pulses[ch];
+  *p++ = ch;
+  *p++ = r->seq;
+  *p++ = r->direction;
+  p = proto_put16(p, r->samples);
+  p = proto_put16(p, r->peak_ma);
+  p = proto_put16(p, r->mean_ma);
+  p = proto_put16(p, r->supply_mv);
+  return proto_put32(p, r->energy_mj);
+}
+
+static unsigned long proto_get32(const unsigned char *p)
+{
+  return ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16)
+    | ((unsigned short) p[2] << 8) | p[3];
+}
+
+// Queue a frame, or drop it if it does not fit in the transmit ring.
+static void proto_send(unsigned char op, const unsigned char *data,
+                       unsigned char len)
+{
+  unsigned char crc, i;
+
+  if(sci_tx_free() < len + 4)
+  {
+    proto_tx_drops++;
+    return;
+  }
+
+  sci_putc(PROTO_SYNC);
+  sci_putc(len);
+  sci_putc(op);
+  crc = proto_crc8(proto_crc8(0, len), op);
+  for(i = 0; i < len; i++)
+  {
+    sci_putc(data[i]);
+    crc = proto_crc8(crc, data[i]);
+  }
+  sci_putc(crc);
+}
+
+static void proto_nak(unsigned char op, unsigned char error)
+{
+  unsigned char data[2];
+
+  data[0] = op;
+  data[1] = error;
+  proto_send(PROTO_NAK, data, 2);
+}
+
+// Carry out the request in proto_buf and reply.  The reply is built in
+// place of the request.
+static void proto_exec(void)
+{
+  unsigned char *p;
+  unsigned char ch;
+  unsigned long on_us, dead_us;
+  stats_acc_t copy;
+
+  p = proto_buf;
+  ch = proto_buf[0];
+  switch(proto_op)
+  {
+    case PROTO_PING:
+      *p++ = PROTO_VERSION;
+      *p++ = SHUTTER_CHANNELS;
+      break;
+
+    case PROTO_OPEN:
+    case PROTO_CLOSE:
+      if(proto_len != 1 || ch >= SHUTTER_CHANNELS)
+        goto bad;
+      shutter_command(ch, proto_op == PROTO_OPEN ? SHUTTER_CMD_OPEN
+                                                 : SHUTTER_CMD_CLOSE);
+      p++;
+      *p++ = shutters[ch].state;
+      break;
+
+    case PROTO_SET_PULSE:
+      if(proto_len != 9 || (ch >= SHUTTER_CHANNELS && ch != 0xFF))
+        goto bad;
+      on_us = proto_get32(&proto_buf[1]);
+      dead_us = proto_get32(&proto_buf[5]);
+      if(on_us < PULSE_MIN_US || on_us > PULSE_MAX_US
+         || dead_us < PULSE_MIN_US || dead_us > PULSE_MAX_US)
+        goto bad;
+      for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+      {
+        if(proto_buf[0] != 0xFF && proto_buf[0] != ch)
+          continue;
+        shutters[ch].on_us = on_us;
+        shutters[ch].dead_us = dead_us;
+      }
+      break;
+
+    case PROTO_GET_COUNTERS:
+      if(proto_len != 1 || ch >= SHUTTER_CHANNELS)
+        goto bad;
+      p++;
+      *p++ = shutters[ch].state;
+      *p++ = shutters[ch].fault;
+      *p++ = endurance[ch].status;
+      p = proto_put32(p, endurance[ch].cycles);
+      p = proto_put32(p, endurance[ch].total);
+      p = proto_put16(p, shutters[ch].queue_drops);
+      break;
+
+    case PROTO_GET_STATS:
+#ifdef SENSE_ENABLE
+      if(proto_len != 1 || ch > PROTO_STATS_CLOSE)
+        goto bad;
+      stats_copy(&copy, ch == PROTO_STATS_RTI ? &stats_rti
+                        : ch == PROTO_STATS_COIL ? &stats_coil
+                        : &stats_travel[ch - PROTO_STATS_OPEN]);
+#else
+      if(proto_len != 1 || ch > PROTO_STATS_COIL)
+        goto bad;
+      stats_copy(&copy, ch == PROTO_STATS_RTI ? &stats_rti : &stats_coil);
+#endif
+      p++;
+      p = proto_put32(p, copy.count);
+      p = proto_put16(p, copy.count ? copy.min : 0);
+      p = proto_put16(p, stats_mean(&copy));
+      p = proto_put16(p, copy.max);
+      break;
+
+    case PROTO_SET_BAUD:
+      if(proto_len != 4)
+        goto bad;
+      ch = sci_rate_find(proto_get32(proto_buf));
+      if(ch == SCI_RATES || !sci_baud_request(sci_rates[ch].baud))
+        goto bad;
+      p = proto_put32(p, sci_rates[ch].baud);
+      break;
+
+    case PROTO_BAUD_CONFIRM:
+      if(proto_len != 0)
+        goto bad;
+      if(!sci_baud_confirm())
+      {
+        proto_nak(proto_op, PROTO_ERR_STATE);
+        return;
+      }
+      p = proto_put32(p, sci_baud());
+      break;
+
+#ifdef SENSE_ENABLE
+    case PROTO_GET_TRAVEL:
+      if(proto_len != 0)
+        goto bad;
+      p = proto_put16(p, sense.travel[0]);
+      p = proto_put16(p, sense.travel[1]);
+      *p++ = sense.result[0];
+      *p++ = sense.result[1];
+      p = proto_put16(p, sense.stalls);
+      p = proto_put16(p, sense.cuts);
+      break;
+#endif
+
+    case PROTO_GET_PULSE:
+      if(proto_len != 1 || ch >= ADC_CHANNELS)
+        goto bad;
+      p = proto_put_pulse(p, ch);
+      break;
+
+    case PROTO_GUARD:
+      if(proto_len != 1 || ch > 1)
+        goto bad;
+      *p++ = guard.fault;
+      *p++ = guard.channel;
+      p = proto_put16(p, guard.faults);
+      if(ch)
+        guard_clear();
+      break;
+
+    case PROTO_TELEMETRY:
+      if(proto_len != 2 || (proto_buf[0] & 0x80))
+        goto bad;
+      proto_tel_ticks = (proto_buf[0] << 8) | proto_buf[1];
+      proto_tel_next = (unsigned short) timebase_ticks();
+      for(ch = 0; ch < ADC_CHANNELS; ch++)
+        proto_pulse_seq[ch] = adc_pulses[ch].seq;
+      break;
+
+    default:
+      proto_nak(proto_op, PROTO_ERR_OPCODE);
+      return;
+  }
+  proto_send(proto_op | PROTO_REPLY, proto_buf, p - proto_buf);
+  return;
+
+bad:
+  proto_nak(proto_op, PROTO_ERR_ARG);
+}
+
+// Take one received byte.  Returns 0 if it is not part of a frame, for
+// the line editor to use.
+unsigned char proto_rx(unsigned char c)
+{
+  unsigned short now;
+
+  now = (unsigned short) timebase_ticks();
+  if(proto_state != PROTO_HUNT
+     && (unsigned short) (now - proto_last) > PROTO_TIMEOUT_TICKS)
+  {
+    proto_rx_errors++;
+    proto_state = PROTO_HUNT;
+  }
+  proto_last = now;
+
+  switch(proto_state)
+  {
+    case PROTO_HUNT:
+      if(c != PROTO_SYNC)
+        return 0;
+      proto_state = PROTO_LEN;
+      break;
+
+    case PROTO_LEN:
+      if(c > PROTO_MAX_PAYLOAD)
+      {
+        proto_rx_errors++;
+        proto_nak(0, PROTO_ERR_LENGTH);
+        proto_state = PROTO_HUNT;
+        break;
+      }
+      proto_len = c;
+      proto_crc = proto_crc8(0, c);
+      proto_state = PROTO_OP;
+      break;
+
+    case PROTO_OP:
+      proto_op = c;
+      proto_crc = proto_crc8(proto_crc, c);
+      proto_pos = 0;
+      proto_state = proto_len ? PROTO_DATA : PROTO_CRC;
+      break;
+
+    case PROTO_DATA:
+      proto_buf[proto_pos++] = c;
+      proto_crc = proto_crc8(proto_crc, c);
+      if(proto_pos == proto_len)
+        proto_state = PROTO_CRC;
+      break;
+
+    default:
+      proto_state = PROTO_HUNT;
+      if(c != proto_crc)
+      {
+        proto_rx_errors++;
+        proto_nak(proto_op, PROTO_ERR_CRC);
+        break;
+      }
+      proto_active = 1;
+      proto_exec();
+      break;
+  }
+  return 1;
+}
+
+// Send the record of each new pulse, and a telemetry frame when one is
+// due.  Runs on every tick.
+void proto_task(void)
+{
+  unsigned char data[4 + 5 * SHUTTER_CHANNELS];
+  unsigned char *p;
+  unsigned long ticks;
+  unsigned char ch;
+
+  if(proto_tel_ticks == 0)
+    return;
+
+  for(ch = 0; ch < ADC_CHANNELS; ch++)
+  {
+    if(adc_pulses[ch].seq == proto_pulse_seq[ch])
+      continue;
+    proto_pulse_seq[ch] = adc_pulses[ch].seq;
+    p = proto_put_pulse(data, ch);
+    proto_send(PROTO_EVENT_PULSE, data, p - data);
+  }
+
+  ticks = timebase_ticks();
+  if((short) ((unsigned short) ticks - proto_tel_next) < 0)
+    return;
+  proto_tel_next += proto_tel_ticks;
+
+  p = proto_put32(data, ticks);
+  for(ch = 0; ch < SHUTTER_CHANNELS; ch++)
+  {
+    *p++ = shutters[ch].state;
+    p = proto_put32(p, endurance[ch].total);
+  }
+  proto_send(PROTO_EVENT, data, p - data);
+}
+
+#endif
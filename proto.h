@@ -0,0 +1,116 @@
+/*  Filename:       proto.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the binary serial protocol,
+    which lets a host program drive the jig.  It shares the serial line
+    with the prompt: a frame starts with PROTO_SYNC, which no text line
+    contains.  A frame is
+
+      PROTO_SYNC, length, opcode, payload (length bytes), CRC-8
+
+    with the CRC taken over the length, opcode and payload.  Values are
+    big-endian.  Each request gets a reply with the opcode plus
+    PROTO_REPLY, or a PROTO_NAK frame holding the opcode and an error
+    code.  Telemetry frames come unasked once turned on: a periodic one,
+    and one for each coil pulse measured.
+
+    After the reply to PROTO_SET_BAUD the jig changes rate, and goes
+    back to the old one unless PROTO_BAUD_CONFIRM comes at the new rate
+    within SCI_CONFIRM_TICKS.
+
+    The frame layout, opcodes and CRC are also used by the host library
+    in sim/jigproto.c.
+
+    The protocol is only built with PROTO_ENABLE defined (make PROTO=1,
+    and always in the host build); proto_crc8 is there either way.
+*/
+
+#ifndef _PROTO_H
+#define _PROTO_H
+
+#define PROTO_SYNC          0xA5
+#define PROTO_VERSION       1
+#define PROTO_MAX_PAYLOAD   32
+
+/* Opcodes and their payloads (request / reply).  ch is 0-based.  */
+#define PROTO_PING          0x01        /* - / version, channels */
+#define PROTO_OPEN          0x02        /* ch / ch, state */
+#define PROTO_CLOSE         0x03        /* ch / ch, state */
+#define PROTO_SET_PULSE     0x04        /* ch (0xFF: all), on_us:4, dead_us:4 / - */
+#define PROTO_GET_COUNTERS  0x05        /* ch / ch, state, fault, endurance status,
+                                           cycles:4, total:4, queue drops:2 */
+#define PROTO_GET_STATS     0x06        /* which / which, count:4, min:2, mean:2,
+                                           max:2 (TCNT ticks) */
+#define PROTO_TELEMETRY     0x07        /* period in ticks:2 (0: off, < 0x8000) / - */
+#define PROTO_SET_BAUD      0x08        /* baud:4 / baud:4 (the rate it will be) */
+#define PROTO_BAUD_CONFIRM  0x09        /* - / baud:4, sent at the new rate;
+                                           PROTO_ERR_STATE if no rate waits
+                                           to be confirmed */
+#define PROTO_GET_TRAVEL    0x0A        /* - / open:2, close:2 (TCNT ticks),
+                                           open result, close result,
+                                           stalls:2, cut short:2; channel 0,
+                                           with the sensors (sense.h) only */
+#define PROTO_GET_PULSE     0x0B        /* ch / last pulse (adc.h): ch, seq,
+                                           direction, samples:2, peak mA:2,
+                                           mean mA:2, supply mV:2, mJ:4 */
+#define PROTO_GUARD         0x0C        /* clear (1: clear the latched fault
+                                           after the reply) / fault, ch,
+                                           faults:2 (guard.h) */
+#define PROTO_EVENT         0x40        /* telemetry: ticks:4, then for each
+                                           channel state, total:4 */
+#define PROTO_EVENT_PULSE   0x41        /* telemetry: as the PROTO_GET_PULSE
+                                           reply, once for each new pulse */
+#define PROTO_REPLY         0x80
+#define PROTO_NAK           0xFF        /* opcode, error */
+
+/* Statistics for PROTO_GET_STATS.  */
+#define PROTO_STATS_RTI     0
+#define PROTO_STATS_COIL    1
+#define PROTO_STATS_OPEN    2           /* travel times, with the sensors */
+#define PROTO_STATS_CLOSE   3
+
+/* Error codes.  */
+#define PROTO_ERR_CRC       1
+#define PROTO_ERR_OPCODE    2
+#define PROTO_ERR_ARG       3
+#define PROTO_ERR_LENGTH    4
+#define PROTO_ERR_STATE     5           /* not now (no rate to confirm) */
+
+/* Add one byte to a CRC-8 (polynomial x^8 + x^2 + x + 1, start 0).  */
+inline static unsigned char proto_crc8 (unsigned char crc, unsigned char c)
+{
+  unsigned char i;
+
+  crc ^= c;
+  for(i = 0; i < 8; i++)
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  return crc;
+}
+
+#ifdef PROTO_ENABLE
+
+/* != 0 once a good frame came in, until the next text line; the clock
+   is then kept off the serial line.  */
+extern unsigned char proto_active;
+
+/* Frames dropped: bad CRC or length, cut short, or no room to reply.  */
+extern unsigned short proto_rx_errors;
+extern unsigned short proto_tx_drops;
+
+extern void proto_init (void);
+extern void proto_clear (void);
+extern unsigned char proto_rx (unsigned char c);
+extern void proto_task (void);
+
+#else
+
+#define proto_active        0
+#define proto_init()        do { } while(0)
+#define proto_clear()       do { } while(0)
+#define proto_rx(C)         0
+
+#endif
+
+#endif
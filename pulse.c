@@ -0,0 +1,327 @@
+/*  Filename:       pulse.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Pulse engine for the H-bridges.  Each bridge (channel)
+    has an open and a close half; a pulse drives one half for on_us and
+    then keeps the channel busy for dead_us, in three phases:
+
+      LEAD  the pin is set a little after the request,
+      ON    the pin is cleared on_us later,
+      DEAD  dead_us later the channel is released and the engine is free.
+
+    Channel 0 drives PA5 and PA4, the OC3 and OC4 pins.  Its interrupt
+    only re-arms the compare between edges, so the pulse width is exact
+    to one TCNT tick whatever the foreground is doing.  Phases longer
+    than half a turn of TCNT are split into several compares; during the
+    ON phase the intermediate compares keep the "set" action so the pin
+    does not move until the last one.  When other interrupts hold the
+    handler up past the end of a short phase, the edge is forced through
+    CFORC instead of waiting for TCNT to come round again.
+
+    The other channels have no compare left to them.  pulse_tick, called
+    by the RTI handler, sets and clears their pins, so their phases are
+    whole RTI periods (4.096ms) long.  The pins are listed in pulse_pins.
+
+    Each pulse is announced to the supervisor (guard.h) before it starts,
+    and none is taken while the supervisor has a fault latched.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "guard.h"
+
+// Delay between the request and the leading edge, long enough for
+// shutter_pulse to finish arming the compare.
+#define PULSE_LEAD_TICKS  8
+
+// Longest single compare step, in TCNT ticks.
+#define PULSE_CHUNK       0x8000
+
+#define PULSE_IDLE      0
+#define PULSE_LEAD      1
+#define PULSE_ON        2
+#define PULSE_DEAD      3
+
+// Pins of each channel.  Port B and C are the address and data bus on
+// this board, so the extra bridges go on the free Port D and Port A
+// bits.  PA7 is made an output by pulse_init.
+const struct pulse_pins pulse_pins[PULSE_CHANNELS] =
+{
+  { M6811_PORTA, PA5, PA4 },            // OC3 and OC4
+  { M6811_PORTD, PD2, PD3 },
+  { M6811_PORTD, PD4, PD5 },
+  { M6811_PORTA, PA6, PA7 }
+};
+
+static volatile unsigned char pulse_state[PULSE_CHANNELS];
+
+// TCNT value of the leading edge of the last pulse.
+static unsigned short pulse_lead[PULSE_CHANNELS];
+
+// Compare register, flag and TCTL1 bits of the channel 0 half in use.
+static unsigned char pulse_toc;
+static unsigned char pulse_flag;
+static unsigned char pulse_om;
+static unsigned char pulse_ol;
+
+static unsigned long pulse_on_ticks;
+static unsigned long pulse_dead_ticks;
+
+// Ticks left in the current phase after the armed compare.
+static unsigned long pulse_left;
+
+// The other channels: the pin driven and the RTI periods of the phases.
+static unsigned char pulse_pin[PULSE_CHANNELS];
+static unsigned short pulse_on_rti[PULSE_CHANNELS];
+static unsigned short pulse_dead_rti[PULSE_CHANNELS];
+static unsigned short pulse_left_rti[PULSE_CHANNELS];
+
+#define PULSE_TOC  (((unsigned volatile short*) &_io_ports[pulse_toc])[0])
+
+// Convert microseconds into TCNT ticks, within the engine limits.
+static unsigned long pulse_ticks(unsigned long us)
+{
+  if(us < PULSE_MIN_US)
+    us = PULSE_MIN_US;
+  if(us > PULSE_MAX_US)
+    us = PULSE_MAX_US;
+  return (us * (TCNT_RATE / 1000L)) / 1000L;
+}
+
+// Convert microseconds into RTI periods (at least one), rounded.
+static unsigned short pulse_rti(unsigned long us)
+{
+  if(us > PULSE_MAX_US)
+    us = PULSE_MAX_US;
+  us = (us + TB_RTI_US / 2) / TB_RTI_US;
+  return us ? (unsigned short) us : 1;
+}
+
+// Arm the next compare of the current phase.  The last step of the ON
+// phase also turns the compare action to "clear".  Returns != 0 when the
+// armed compare ends the phase.
+static unsigned char pulse_step(void)
+{
+  unsigned short now;
+
+  if(pulse_left > PULSE_CHUNK + US_TO_TCNT(PULSE_MIN_US))
+  {
+    PULSE_TOC += PULSE_CHUNK;
+    pulse_left -= PULSE_CHUNK;
+    return 0;
+  }
+
+  PULSE_TOC += (unsigned short) pulse_left;
+  pulse_left = 0;
+  if(pulse_state[0] == PULSE_ON)
+    _io_ports[M6811_TCTL1] &= ~pulse_ol;
+
+  // If this handler was held up for longer than the phase, the compare
+  // is already behind TCNT and would only match a whole turn (524ms)
+  // later.  Take the edge now and re-arm just ahead to move on.
+  now = get_timer_counter();
+  if((short) (PULSE_TOC - now) < PULSE_LEAD_TICKS)
+  {
+    _io_ports[M6811_CFORC] = pulse_flag;             // FOCx matches OCxF
+    PULSE_TOC = now + PULSE_LEAD_TICKS;
+  }
+  return 1;
+}
+
+// Output compare 3 and 4 interrupt handler (channel 0).
+void __attribute__((interrupt)) pulse_interrupt(void)
+{
+  SCHED_WAKE();
+  _io_ports[M6811_TFLG1] = pulse_flag;
+
+  switch(pulse_state[0])
+  {
+    case PULSE_LEAD:
+      // The pin was just set; clear it when the on time is over.
+      pulse_left = pulse_on_ticks;
+      pulse_state[0] = PULSE_ON;
+      pulse_step();
+      break;
+
+    case PULSE_ON:
+      if(pulse_left)
+      {
+        pulse_step();
+        break;
+      }
+
+      // The pin was just cleared; hand it back to PORTA (which holds 0)
+      // and wait for the dead time.
+      _io_ports[M6811_TCTL1] &= ~pulse_om;
+      pulse_left = pulse_dead_ticks;
+      pulse_state[0] = PULSE_DEAD;
+      pulse_step();
+      sched_post(SCHED_EV_PULSE);
+      break;
+
+    default:
+      if(pulse_left)
+      {
+        pulse_step();
+        break;
+      }
+
+      _io_ports[M6811_TMSK1] &= ~pulse_flag;
+      pulse_state[0] = PULSE_IDLE;
+      guard_idle(0);
+      sched_post(SCHED_EV_PULSE);
+      break;
+  }
+}
+
+// Advance the channels other than 0.  Called from the RTI interrupt.
+void pulse_tick(void)
+{
+  unsigned char ch;
+
+  for(ch = 1; ch < PULSE_CHANNELS; ch++)
+  {
+    switch(pulse_state[ch])
+    {
+      case PULSE_LEAD:
+        _io_ports[pulse_pins[ch].port] |= pulse_pin[ch];
+        pulse_lead[ch] = get_timer_counter();
+        pulse_left_rti[ch] = pulse_on_rti[ch];
+        pulse_state[ch] = PULSE_ON;
+        break;
+
+      case PULSE_ON:
+        if(--pulse_left_rti[ch])
+          break;
+        _io_ports[pulse_pins[ch].port] &= ~pulse_pin[ch];
+        pulse_left_rti[ch] = pulse_dead_rti[ch];
+        pulse_state[ch] = PULSE_DEAD;
+        sched_post(SCHED_EV_PULSE);
+        break;
+
+      case PULSE_DEAD:
+        if(--pulse_left_rti[ch])
+          break;
+        pulse_state[ch] = PULSE_IDLE;
+        guard_idle(ch);
+        sched_post(SCHED_EV_PULSE);
+        break;
+    }
+  }
+}
+
+// Leave every bridge half off.  Channel 0 is left under PORTA control.
+// This is also the safe idle state the supervisor puts the bridges in.
+void pulse_init(void)
+{
+  unsigned short mask;
+  unsigned char ch;
+
+  mask = lock();
+  _io_ports[M6811_TMSK1] &= ~(M6811_OC3I | M6811_OC4I);
+  _io_ports[M6811_TCTL1] &= ~(M6811_OM3 | M6811_OL3 | M6811_OM4 | M6811_OL4);
+  for(ch = 0; ch < PULSE_CHANNELS; ch++)
+  {
+    _io_ports[pulse_pins[ch].port] &= ~(pulse_pins[ch].open | pulse_pins[ch].close);
+    if(pulse_pins[ch].port == M6811_PORTD)
+      _io_ports[M6811_DDRD] |= pulse_pins[ch].open | pulse_pins[ch].close;
+    pulse_state[ch] = PULSE_IDLE;
+  }
+  _io_ports[M6811_PACTL] |= M6811_DDRA7;
+  restore(mask);
+}
+
+// Start a pulse on one half of a bridge followed by a dead time.
+// Returns 0 if a pulse is already in progress on that channel, or if
+// the supervisor has a fault latched.
+unsigned char shutter_pulse(unsigned char ch, unsigned char direction,
+                            unsigned long on_us, unsigned long dead_us)
+{
+  unsigned short mask;
+
+  if(pulse_state[ch] != PULSE_IDLE || guard.fault != GUARD_OK)
+    return 0;
+  guard_arm(ch, on_us);
+
+  if(ch != 0)
+  {
+    // The next RTI sets the pin.
+    pulse_pin[ch] = direction == PULSE_OPEN ? pulse_pins[ch].open
+                                            : pulse_pins[ch].close;
+    pulse_on_rti[ch] = pulse_rti(on_us);
+    pulse_dead_rti[ch] = pulse_rti(dead_us);
+    pulse_state[ch] = PULSE_LEAD;
+    return 1;
+  }
+
+  if(direction == PULSE_OPEN)
+  {
+    pulse_toc = M6811_TOC3;
+    pulse_flag = M6811_OC3F;
+    pulse_om = M6811_OM3;
+    pulse_ol = M6811_OL3;
+  }
+  else
+  {
+    pulse_toc = M6811_TOC4;
+    pulse_flag = M6811_OC4F;
+    pulse_om = M6811_OM4;
+    pulse_ol = M6811_OL4;
+  }
+  pulse_on_ticks = pulse_ticks(on_us);
+  pulse_dead_ticks = pulse_ticks(dead_us);
+
+  mask = lock();
+  _io_ports[M6811_TCTL1] |= pulse_om | pulse_ol;      // set on compare
+  pulse_lead[0] = get_timer_counter() + PULSE_LEAD_TICKS;
+  PULSE_TOC = pulse_lead[0];
+  _io_ports[M6811_TFLG1] = pulse_flag;
+  _io_ports[M6811_TMSK1] |= pulse_flag;              // OCxI matches OCxF
+  pulse_state[0] = PULSE_LEAD;
+  restore(mask);
+  return 1;
+}
+
+// End the channel 0 pulse now, because the shutter got to the end of
+// its travel, and start the dead time.  Called from the input capture
+// interrupt (see sense.c).  Returns 0 if the pulse was not on.
+unsigned char pulse_cut(void)
+{
+  if(pulse_state[0] != PULSE_ON)
+    return 0;
+
+  // Force the compare action to "clear", then hand the pin back to
+  // PORTA (which holds 0).
+  _io_ports[M6811_TCTL1] &= ~pulse_ol;
+  _io_ports[M6811_CFORC] = pulse_flag;               // FOCx matches OCxF
+  _io_ports[M6811_TCTL1] &= ~pulse_om;
+  _io_ports[M6811_TFLG1] = pulse_flag;
+
+  pulse_left = pulse_dead_ticks;
+  PULSE_TOC = get_timer_counter();
+  pulse_state[0] = PULSE_DEAD;
+  pulse_step();
+  sched_post(SCHED_EV_PULSE);
+  return 1;
+}
+
+// TCNT value at which the last pulse of a channel started.  On channel 0
+// it is known (and may be in the future) as soon as shutter_pulse returns.
+unsigned short pulse_leading_edge(unsigned char ch)
+{
+  return pulse_lead[ch];
+}
+
+// Return != 0 while a pulse or its dead time is in progress.
+unsigned char pulse_busy(unsigned char ch)
+{
+  return pulse_state[ch] != PULSE_IDLE;
+}
+
+// Return != 0 until the pulse in progress has ended.
+unsigned char pulse_driving(unsigned char ch)
+{
+  return pulse_state[ch] == PULSE_LEAD || pulse_state[ch] == PULSE_ON;
+}
@@ -0,0 +1,52 @@
+/*  Filename:       pulse.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the H-bridge pulse engine.
+    Both edges of the channel 0 pulse are produced by the output compare
+    hardware, so the pulse width does not depend on the main loop.  The
+    other channels are switched by the RTI handler.
+*/
+
+#ifndef _PULSE_H
+#define _PULSE_H
+
+/* Pulse directions.  Open drives the open half of the bridge (PA5, OC3
+   on channel 0), close the close half (PA4, OC4).  */
+#define PULSE_OPEN      1
+#define PULSE_CLOSE     2
+
+/* Number of H-bridges.  */
+#define PULSE_CHANNELS  4
+
+/* Limits of the on and dead times, in microseconds.  Shorter phases
+   than the interrupt latency (RTI and OC5 stacked) are stretched to it,
+   because a compare armed late is forced at once (see pulse.c); the
+   upper limit keeps the tick count in 32 bits.  */
+#define PULSE_MIN_US    500L
+#define PULSE_MAX_US    10000000L
+
+/*! Pins of a bridge: the port register and the open and close bits.  */
+struct pulse_pins
+{
+  unsigned char port;
+  unsigned char open;
+  unsigned char close;
+};
+
+extern const struct pulse_pins pulse_pins[PULSE_CHANNELS];
+
+extern void pulse_interrupt (void) __attribute__((interrupt));
+
+extern void pulse_init (void);
+extern void pulse_tick (void);
+extern unsigned char shutter_pulse (unsigned char ch, unsigned char direction,
+                                    unsigned long on_us,
+                                    unsigned long dead_us);
+extern unsigned char pulse_cut (void);
+extern unsigned char pulse_busy (unsigned char ch);
+extern unsigned char pulse_driving (unsigned char ch);
+extern unsigned short pulse_leading_edge (unsigned char ch);
+
+#endif
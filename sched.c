@@ -0,0 +1,151 @@
+/*  Filename:       sched.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Run-to-completion scheduler.  Each pass takes the
+    pending events, runs every task that is ready in table order, and
+    records how long each run took against TCNT.  When no event came in
+    during the pass the CPU executes WAI until the next interrupt.  The
+    check is made with interrupts masked, and unlock_and_wait is CLI
+    then WAI; the HC11 takes no interrupt until the instruction after
+    CLI has started, so an event posted after the check ends the WAI at
+    once and is never left waiting.
+
+    The idle time is measured with TCNT from just before the WAI to the
+    start of the interrupt handler that ends it, so the handlers count
+    as busy time.  WAI keeps the timer and SCI running, which the
+    jig needs; STOP would halt the E clock and with it TCNT and the RTI,
+    and only IRQ, XIRQ or reset could end it.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+
+volatile unsigned char sched_events;
+unsigned long sched_passes;
+unsigned short sched_wcet[SCHED_MAX_TASKS];
+const sched_task_t *sched_tasks;
+unsigned char sched_count;
+
+volatile unsigned char sched_waiting;
+volatile unsigned short sched_woke;
+unsigned long sched_idle_ticks;
+unsigned long sched_waits;
+
+// Tick at which each periodic task is next due.
+static unsigned short sched_due[SCHED_MAX_TASKS];
+
+// Wait for an interrupt unless an event is already pending, and account
+// for the time spent waiting.
+static void sched_idle(void)
+{
+  unsigned short start;
+
+  lock();
+  if(sched_events != 0)
+  {
+    unlock();
+    return;
+  }
+
+  sched_waiting = 1;
+  start = get_timer_counter();
+  unlock_and_wait();
+
+  // A handler without SCHED_WAKE leaves the flag set; count up to now.
+  if(sched_waiting)
+  {
+    sched_waiting = 0;
+    sched_woke = get_timer_counter();
+  }
+  sched_idle_ticks += (unsigned short) (sched_woke - start);
+  sched_waits++;
+}
+
+void sched_window_start(sched_window_t *w)
+{
+  w->start = timebase_now();
+  w->idle = sched_idle_ticks;
+}
+
+// Share of the time spent in WAI since the window started, in tenths of
+// a percent, and start the next window.  This takes a 32-bit divide, so
+// it is for the display only.
+unsigned short sched_idle_share(sched_window_t *w)
+{
+  unsigned long now, elapsed, idle;
+
+  now = timebase_now();
+  elapsed = now - w->start;
+  idle = sched_idle_ticks - w->idle;
+  w->start = now;
+  w->idle = sched_idle_ticks;
+
+  // Keep idle * 1000 within 32 bits.
+  while(elapsed > 0x3FFFFFL)
+  {
+    elapsed >>= 1;
+    idle >>= 1;
+  }
+  if(elapsed == 0)
+    return 0;
+  return (unsigned short) (idle * 1000 / elapsed);
+}
+
+void sched_run(const sched_task_t *tasks, unsigned char count)
+{
+  const sched_task_t *task;
+  unsigned short mask;
+  unsigned short now;
+  unsigned short start, took;
+  unsigned char events;
+  unsigned char ready;
+  unsigned char i;
+
+  sched_tasks = tasks;
+  sched_count = count;
+  sched_passes = 0;
+  sched_waiting = 0;
+  sched_idle_ticks = 0;
+  sched_waits = 0;
+  now = (unsigned short) timebase_ticks();
+  for(i = 0; i < count; i++)
+  {
+    sched_due[i] = now;
+    sched_wcet[i] = 0;
+  }
+
+  while(1)
+  {
+    // Reset the COP (in case it is active).
+    cop_optional_reset();
+    sched_passes++;
+
+    mask = lock();
+    events = sched_events;
+    sched_events = 0;
+    restore(mask);
+
+    now = (unsigned short) timebase_ticks();
+    for(i = 0, task = tasks; i < count; i++, task++)
+    {
+      ready = events & task->events;
+      if(task->period && (short) (now - sched_due[i]) >= 0)
+      {
+        sched_due[i] = now + task->period;
+        ready = 1;
+      }
+      if(!ready)
+        continue;
+
+      start = get_timer_counter();
+      task->run();
+      took = get_timer_counter() - start;
+      if(took > sched_wcet[i])
+        sched_wcet[i] = took;
+    }
+
+    sched_idle();
+  }
+}
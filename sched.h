@@ -0,0 +1,88 @@
+/*  Filename:       sched.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the cooperative scheduler.
+    Tasks run to completion from a static table, either when one of their
+    event bits has been posted by an interrupt handler or when their
+    period (in RTI ticks) has elapsed.  With nothing to do the CPU waits
+    for the next interrupt with WAI, and the time spent waiting is added
+    up so the idle share can be shown.
+*/
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+/* Event bits.  */
+#define SCHED_EV_TICK   0x01            /* an RTI period elapsed */
+#define SCHED_EV_RX     0x02            /* the SCI received a character */
+#define SCHED_EV_PULSE  0x04            /* a pulse or its dead time ended */
+#define SCHED_EV_BUTTON 0x08            /* a button event was queued */
+
+/* Room for tasks in the scheduler's own arrays.  The task table is
+   checked against it where it is defined.  */
+#define SCHED_MAX_TASKS 16
+
+/*! Entry of the task table.  */
+struct sched_task
+{
+  const char *name;
+  void (*run) (void);
+  unsigned char events;                 /* events that make the task ready */
+  unsigned char period;                 /* also run every period ticks (0: never) */
+};
+typedef struct sched_task sched_task_t;
+
+/* Pending events.  Interrupt handlers set bits with sched_post; since
+   they run with interrupts masked they need no further protection.  */
+extern volatile unsigned char sched_events;
+
+#define sched_post(EV)  (sched_events |= (EV))
+
+/* Number of passes through the task table.  */
+extern unsigned long sched_passes;
+
+/* The task table being run, and the longest run of each task, in TCNT
+   ticks.  */
+extern const sched_task_t *sched_tasks;
+extern unsigned char sched_count;
+extern unsigned short sched_wcet[SCHED_MAX_TASKS];
+
+/* Set while the CPU waits in WAI.  Every interrupt handler starts with
+   SCHED_WAKE, so the first one to run after the wait notes the TCNT
+   value at which the CPU woke up, before its own work.  */
+extern volatile unsigned char sched_waiting;
+extern volatile unsigned short sched_woke;
+
+#define SCHED_WAKE() \
+  do \
+  { \
+    if(sched_waiting) \
+    { \
+      sched_woke = get_timer_counter(); \
+      sched_waiting = 0; \
+    } \
+  } while(0)
+
+/* Time spent in WAI, in TCNT ticks, and number of waits.  Both only
+   change in the main loop; the W command starts the count of waits
+   again.  */
+extern unsigned long sched_idle_ticks;
+extern unsigned long sched_waits;
+
+/*! Interval over which the idle share is measured.  */
+struct sched_window
+{
+  unsigned long start;                  /* timebase_now at the start */
+  unsigned long idle;                   /* sched_idle_ticks at the start */
+};
+typedef struct sched_window sched_window_t;
+
+extern void sched_window_start (sched_window_t *w);
+extern unsigned short sched_idle_share (sched_window_t *w);
+
+extern void sched_run (const sched_task_t *tasks, unsigned char count)
+  __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,293 @@
+/*  Filename:       sci.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Interrupt-driven SCI driver.  The receive interrupt
+    stores incoming characters in the RX ring.  serial_print and sci_putc
+    only queue characters in the TX ring; the transmit interrupt is enabled
+    while the ring holds data and moves one character to SCDR each time
+    the transmitter becomes empty.
+
+    This serial_print replaces the polled one from libbsp.  When it is
+    called with interrupts masked (from fatal_interrupt for instance) it
+    falls back to polling so the message still goes out.
+
+    A rate change first lets the transmitter finish at the old rate, so
+    the reply that announced it gets through.  The new rate then waits
+    SCI_CONFIRM_TICKS for sci_baud_confirm, and the old one is put back
+    if it does not come.  Characters with a framing error, most likely
+    sent at the other rate, are dropped in the meantime.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+
+#define SCI_RX_MASK     (SCI_RX_SIZE - 1)
+#define SCI_TX_MASK     (SCI_TX_SIZE - 1)
+
+static char sci_rx_ring[SCI_RX_SIZE];
+static volatile unsigned char sci_rx_head;
+static volatile unsigned char sci_rx_tail;
+
+static char sci_tx_ring[SCI_TX_SIZE];
+static volatile unsigned char sci_tx_head;
+static volatile unsigned char sci_tx_tail;
+
+unsigned short sci_rx_overruns;
+unsigned short sci_tx_overruns;
+unsigned short sci_rx_framing;
+
+#define SCI_RATE_ROW(SCP, BITS) \
+  { SCI_RATE(SCP, 0), (BITS) | 0 }, { SCI_RATE(SCP, 1), (BITS) | 1 }, \
+  { SCI_RATE(SCP, 2), (BITS) | 2 }, { SCI_RATE(SCP, 3), (BITS) | 3 }, \
+  { SCI_RATE(SCP, 4), (BITS) | 4 }, { SCI_RATE(SCP, 5), (BITS) | 5 }, \
+  { SCI_RATE(SCP, 6), (BITS) | 6 }, { SCI_RATE(SCP, 7), (BITS) | 7 }
+
+// The rates of every BAUD value at M6811_CPU_CLOCK, worked out by the
+// compiler.
+const struct sci_rate sci_rates[SCI_RATES] =
+{
+  SCI_RATE_ROW(1, M6811_BAUD_DIV_1),
+  SCI_RATE_ROW(3, M6811_BAUD_DIV_3),
+  SCI_RATE_ROW(4, M6811_BAUD_DIV_4),
+  SCI_RATE_ROW(13, M6811_BAUD_DIV_13)
+};
+
+// Rate change: the state, the BAUD value to go back to and the tick by
+// which the new rate must be confirmed.
+static unsigned char sci_baud_state;
+static unsigned char sci_baud_old;
+static unsigned char sci_baud_new;
+static unsigned short sci_baud_deadline;
+
+// SCI interrupt handler: receive and transmit one character each.
+void __attribute__((interrupt)) sci_interrupt(void)
+{
+  unsigned char status;
+  unsigned char head, next, tail;
+  char c;
+
+  SCHED_WAKE();
+  status = _io_ports[M6811_SCSR];
+
+  // Reading SCDR after SCSR clears RDRF and the overrun and framing
+  // error flags.
+  if(status & (M6811_RDRF | M6811_OR))
+  {
+    c = _io_ports[M6811_SCDR];
+    head = sci_rx_head;
+    next = (head + 1) & SCI_RX_MASK;
+    if(status & M6811_FE)
+    {
+      sci_rx_framing++;
+    }
+    else if(next != sci_rx_tail)
+    {
+      sci_rx_ring[head] = c;
+      sci_rx_head = next;
+      sched_post(SCHED_EV_RX);
+    }
+    else
+    {
+      sci_rx_overruns++;
+    }
+
+    // OR: the character after this one came in before it was read, and
+    // the SCI dropped it.
+    if(status & M6811_OR)
+      sci_rx_overruns++;
+  }
+
+  if((status & M6811_TDRE) && (_io_ports[M6811_SCCR2] & M6811_TIE))
+  {
+    tail = sci_tx_tail;
+    if(tail == sci_tx_head)
+    {
+      // Nothing left to send.
+      _io_ports[M6811_SCCR2] &= ~M6811_TIE;
+    }
+    else
+    {
+      _io_ports[M6811_SCDR] = sci_tx_ring[tail];
+      sci_tx_tail = (tail + 1) & SCI_TX_MASK;
+    }
+  }
+}
+
+// Configure the SCI and enable the receive interrupt.
+void sci_init(void)
+{
+  // RAM is not cleared at reset.
+  sci_rx_head = sci_rx_tail = 0;
+  sci_tx_head = sci_tx_tail = 0;
+  sci_rx_overruns = 0;
+  sci_tx_overruns = 0;
+  sci_rx_framing = 0;
+  sci_baud_state = SCI_BAUD_IDLE;
+
+  serial_init();
+  _io_ports[M6811_SCCR2] |= M6811_RIE;
+}
+
+// Queue a character for transmission.  The character is dropped
+// if the ring is full.
+void sci_putc(char c)
+{
+  unsigned short mask;
+  unsigned char head, next;
+
+  mask = lock();
+  if((mask >> 8) & M6811_I_BIT)
+  {
+    // Interrupts were already masked, the ring would never drain.
+    restore(mask);
+    serial_send(c);
+    return;
+  }
+
+  head = sci_tx_head;
+  next = (head + 1) & SCI_TX_MASK;
+  if(next == sci_tx_tail)
+  {
+    sci_tx_overruns++;
+  }
+  else
+  {
+    sci_tx_ring[head] = c;
+    sci_tx_head = next;
+    _io_ports[M6811_SCCR2] |= M6811_TIE;
+  }
+  restore(mask);
+}
+
+// Write the string on the serial line.
+void serial_print(const char *msg)
+{
+  while(*msg)
+    sci_putc(*msg++);
+}
+
+// Fetch a received character.  Returns 0 if there is none.
+unsigned char sci_getc(char *c)
+{
+  unsigned char tail;
+
+  tail = sci_rx_tail;
+  if(tail == sci_rx_head)
+    return 0;
+
+  *c = sci_rx_ring[tail];
+  sci_rx_tail = (tail + 1) & SCI_RX_MASK;
+  return 1;
+}
+
+// Return != 0 if there is something in the receive ring.
+unsigned char sci_rx_pending(void)
+{
+  return sci_rx_head != sci_rx_tail;
+}
+
+// Return the number of characters the transmit ring can still take.
+unsigned char sci_tx_free(void)
+{
+  return (sci_tx_tail - sci_tx_head - 1) & SCI_TX_MASK;
+}
+
+// Find the BAUD value closest to a rate, up to SCI_MAX_BAUD.  Returns
+// its index in sci_rates, or SCI_RATES if none is within the tolerance.
+unsigned char sci_rate_find(unsigned long baud)
+{
+  unsigned long err, best_err;
+  unsigned char i, best;
+
+  best = SCI_RATES;
+  best_err = baud / SCI_BAUD_TOLERANCE;
+  for(i = 0; i < SCI_RATES; i++)
+  {
+    if(sci_rates[i].baud > SCI_MAX_BAUD)
+      continue;
+    err = sci_rates[i].baud > baud ? sci_rates[i].baud - baud
+                                   : baud - sci_rates[i].baud;
+    if(err <= best_err)
+    {
+      best_err = err;
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Current rate, in baud.
+unsigned long sci_baud(void)
+{
+  unsigned char reg, i;
+
+  reg = _io_ports[M6811_BAUD] & (M6811_SCP1 | M6811_SCP0 | M6811_SCR2
+                                 | M6811_SCR1 | M6811_SCR0);
+  for(i = 0; i < SCI_RATES; i++)
+    if(sci_rates[i].reg == reg)
+      break;
+  return sci_rates[i].baud;
+}
+
+// Ask for a new rate.  It is taken up once the transmit ring is empty,
+// so a reply queued before this call still goes at the old rate.
+// Returns 0 if the rate cannot be made or a change is in progress.
+unsigned char sci_baud_request(unsigned long baud)
+{
+  unsigned char i;
+
+  i = sci_rate_find(baud);
+  if(i == SCI_RATES || sci_baud_state != SCI_BAUD_IDLE)
+    return 0;
+
+  sci_baud_old = _io_ports[M6811_BAUD];
+  sci_baud_new = sci_rates[i].reg;
+  sci_baud_state = SCI_BAUD_DRAIN;
+  return 1;
+}
+
+// The host can talk at the new rate: keep it.  Returns 0 if no rate
+// was waiting to be confirmed.
+unsigned char sci_baud_confirm(void)
+{
+  if(sci_baud_state != SCI_BAUD_CONFIRM)
+    return 0;
+  sci_baud_state = SCI_BAUD_IDLE;
+  return 1;
+}
+
+// Return != 0 while a new rate waits to be confirmed.
+unsigned char sci_baud_waiting(void)
+{
+  return sci_baud_state == SCI_BAUD_CONFIRM;
+}
+
+// Move a rate change along.  Runs on every tick; returns the state, and
+// SCI_BAUD_REVERTED once when the old rate has been put back.
+unsigned char sci_baud_task(void)
+{
+  unsigned short now;
+
+  now = (unsigned short) timebase_ticks();
+  switch(sci_baud_state)
+  {
+    case SCI_BAUD_DRAIN:
+      // The ring is empty and the last character has left the shifter.
+      if(sci_tx_head != sci_tx_tail || !(_io_ports[M6811_SCSR] & M6811_TC))
+        break;
+      _io_ports[M6811_BAUD] = sci_baud_new;
+      sci_baud_deadline = now + SCI_CONFIRM_TICKS;
+      sci_baud_state = SCI_BAUD_CONFIRM;
+      break;
+
+    case SCI_BAUD_CONFIRM:
+      if((short) (now - sci_baud_deadline) < 0)
+        break;
+      _io_ports[M6811_BAUD] = sci_baud_old;
+      sci_baud_state = SCI_BAUD_IDLE;
+      return SCI_BAUD_REVERTED;
+  }
+  return sci_baud_state;
+}
@@ -0,0 +1,78 @@
+/*  Filename:       sci.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the interrupt-driven SCI
+    driver.  Received characters and characters waiting to be sent are
+    kept in RAM ring buffers serviced by the SCI interrupt, so nothing in
+    the main loop waits on the serial line.
+
+    The baud rate starts at M6811_DEF_BAUD and can be changed at run
+    time.  A new rate only stays if the host confirms it within
+    SCI_CONFIRM_TICKS; otherwise the old one comes back, so a host that
+    could not follow does not lose the jig.
+*/
+
+#ifndef _SCI_H
+#define _SCI_H
+
+/* Ring sizes (must be powers of 2, at most 256).  */
+#define SCI_RX_SIZE     32
+#define SCI_TX_SIZE     256
+
+/* Rate given by the SCP prescaler (1, 3, 4 or 13) and the SCR divider
+   (0 to 7), in baud.  */
+#define SCI_RATE(SCP, SCR)  (M6811_CPU_E_CLOCK / (16L * (SCP) * (1L << (SCR))))
+
+/*! Rate of one BAUD register value.  */
+struct sci_rate
+{
+  unsigned long baud;
+  unsigned char reg;
+};
+
+/* Every SCP and SCR setting (see sci.c).  */
+#define SCI_RATES       32
+extern const struct sci_rate sci_rates[SCI_RATES];
+
+/* Fastest rate offered.  The SCI holds one received character while
+   the next one comes in, so the RTI handler (about 230us) must not
+   take longer than a character: 320us at 31250 baud, 160us at 62500.  */
+#define SCI_MAX_BAUD        31250L
+
+/* A rate is close enough if within 1/SCI_BAUD_TOLERANCE (2.5%).  */
+#define SCI_BAUD_TOLERANCE  40
+
+/* Time the host has to confirm a new rate, in RTI ticks (5s).  */
+#define SCI_CONFIRM_TICKS   ((unsigned short) (TIMER_TICK * 5))
+
+/* Progress of a rate change.  */
+#define SCI_BAUD_IDLE       0
+#define SCI_BAUD_DRAIN      1           /* sending what is left at the old rate */
+#define SCI_BAUD_CONFIRM    2           /* new rate on, waiting for the host */
+#define SCI_BAUD_REVERTED   3           /* returned once by sci_baud_task */
+
+extern void sci_interrupt (void) __attribute__((interrupt));
+
+extern void sci_init (void);
+extern void sci_putc (char c);
+extern unsigned char sci_getc (char *c);
+extern unsigned char sci_rx_pending (void);
+extern unsigned char sci_tx_free (void);
+
+extern unsigned long sci_baud (void);
+extern unsigned char sci_rate_find (unsigned long baud);
+extern unsigned char sci_baud_request (unsigned long baud);
+extern unsigned char sci_baud_confirm (void);
+extern unsigned char sci_baud_waiting (void);
+extern unsigned char sci_baud_task (void);
+
+/* Characters lost because a ring was full or the receive interrupt
+   came too late (OR), and characters dropped with a framing error (most
+   likely sent at another rate).  */
+extern unsigned short sci_rx_overruns;
+extern unsigned short sci_tx_overruns;
+extern unsigned short sci_rx_framing;
+
+#endif
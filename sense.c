@@ -0,0 +1,133 @@
+/*  Filename:       sense.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    End-of-travel sensing of channel 0.
+
+    sense_start arms the sensor at the end the pulse drives towards.
+    Its rising edge latches TCNT in the input capture register, so the
+    travel time, from the leading edge of the pulse to the edge of the
+    sensor, is exact to one TCNT tick whatever the interrupt latency.
+    The handler then cuts the pulse short (see pulse_cut) and the dead
+    time starts at once.  Edges of the other sensor, or a second edge
+    from a bouncing switch, are ignored.
+
+    When the pulse and its dead time are over with the sensor still
+    armed, the shutter did not get there: sense_rest counts a stall and
+    the shutter state machine takes the position as unknown.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "stats.h"
+#include "sense.h"
+
+#ifdef SENSE_ENABLE
+
+sense_t sense;
+
+// Pulse being watched: its direction (0 when none), the TCNT value of
+// its leading edge and the RTI tick at which it started.
+static volatile unsigned char sense_dir;
+static unsigned short sense_lead;
+static unsigned short sense_tick;
+
+// Capture the rising edges of both sensors.
+void sense_init(void)
+{
+  unsigned short mask;
+  unsigned char i;
+
+  mask = lock();
+  for(i = 0; i < 2; i++)
+  {
+    sense.travel[i] = 0;
+    sense.result[i] = SENSE_NONE;
+  }
+  sense.stalls = 0;
+  sense.cuts = 0;
+  sense_dir = 0;
+  _io_ports[M6811_TCTL2] = (_io_ports[M6811_TCTL2] & ~(M6811_EDG2B | M6811_EDG3B))
+    | M6811_EDG2A | M6811_EDG3A;
+  _io_ports[M6811_TFLG1] = M6811_IC2F | M6811_IC3F;
+  _io_ports[M6811_TMSK1] |= M6811_IC2I | M6811_IC3I;
+  restore(mask);
+}
+
+// Input capture 2 and 3 interrupt handler.
+void __attribute__((interrupt)) sense_interrupt(void)
+{
+  unsigned short edge;
+  unsigned char flags, i;
+
+  SCHED_WAKE();
+  flags = _io_ports[M6811_TFLG1] & (M6811_IC2F | M6811_IC3F);
+  _io_ports[M6811_TFLG1] = flags;
+
+  if(sense_dir == PULSE_OPEN && (flags & M6811_IC3F))
+    edge = get_input_capture_3();
+  else if(sense_dir == PULSE_CLOSE && (flags & M6811_IC2F))
+    edge = get_input_capture_2();
+  else
+    return;
+
+  // Past the timeout the edge could be a TCNT turn later than it looks;
+  // sense_rest will count the stall.
+  if((unsigned short) ((unsigned short) timebase_ticks() - sense_tick)
+     > SENSE_TIMEOUT_TICKS)
+    return;
+
+  i = sense_dir - 1;
+  sense_dir = 0;
+  sense.travel[i] = edge - sense_lead;
+  sense.result[i] = SENSE_DONE;
+  stats_travel_add(i, sense.travel[i]);
+  if(pulse_cut())
+    sense.cuts++;
+}
+
+// Watch the channel 0 pulse just started in a direction, with its
+// leading edge at TCNT value lead.  If the shutter is already at that
+// end no edge will come, and nothing is measured.
+void sense_start(unsigned char direction, unsigned short lead)
+{
+  unsigned short mask;
+  unsigned char pin;
+
+  pin = direction == PULSE_OPEN ? SENSE_OPEN_PIN : SENSE_CLOSED_PIN;
+
+  mask = lock();
+  sense_dir = 0;
+  sense.result[direction - 1] = SENSE_NONE;
+  if(!(_io_ports[M6811_PORTA] & pin))
+  {
+    // Drop the edges latched since the last pulse.
+    _io_ports[M6811_TFLG1] = M6811_IC2F | M6811_IC3F;
+    sense_lead = lead;
+    sense_tick = (unsigned short) timebase_ticks();
+    sense_dir = direction;
+  }
+  restore(mask);
+}
+
+// The pulse and its dead time are over.  Returns 0, and counts a stall,
+// if the shutter did not get to the end of its travel.
+unsigned char sense_rest(void)
+{
+  unsigned short mask;
+  unsigned char dir;
+
+  mask = lock();
+  dir = sense_dir;
+  sense_dir = 0;
+  restore(mask);
+
+  if(dir == 0)
+    return 1;
+  sense.result[dir - 1] = SENSE_STALL;
+  sense.stalls++;
+  return 0;
+}
+
+#endif
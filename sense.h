@@ -0,0 +1,63 @@
+/*  Filename:       sense.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the end-of-travel sensing
+    of channel 0.  Two sensors, one at each end of the travel, go to
+    input capture pins, so the time at which the shutter gets there is
+    latched by the timer.  The travel time of every pulse is measured,
+    the pulse is ended as soon as the shutter is there, and a pulse after
+    which it never got there is a stall.
+
+    The input capture pins are the channel 0 open and close button
+    inputs, so sensing is only built with SENSE_ENABLE defined (make
+    SENSE=1), for a jig fitted with the sensors; channel 0 then only
+    takes serial commands.
+*/
+
+#ifndef _SENSE_H
+#define _SENSE_H
+
+/* Sensor inputs, which read 1 while the shutter is at that end.  */
+#define SENSE_OPEN_PIN      PA0         /* IC3 */
+#define SENSE_CLOSED_PIN    PA1         /* IC2 */
+
+/* Longest travel, in RTI ticks.  It stays below a turn of TCNT (524ms),
+   so the 16-bit capture times one without ambiguity.  */
+#define SENSE_TIMEOUT_TICKS ((unsigned short) (TIMER_TICK / 2))
+
+/* Outcome of the last pulse in each direction.  */
+#define SENSE_NONE          0           /* not measured */
+#define SENSE_DONE          1           /* got to the end */
+#define SENSE_STALL         2           /* did not get there */
+
+/*! Measurements, indexed by direction - 1 (PULSE_OPEN, PULSE_CLOSE).  */
+struct sense
+{
+  unsigned short travel[2];             /* last travel time, TCNT ticks */
+  unsigned char result[2];
+  unsigned short stalls;
+  unsigned short cuts;                  /* pulses ended early */
+};
+typedef struct sense sense_t;
+
+#ifdef SENSE_ENABLE
+
+extern sense_t sense;
+
+extern void sense_interrupt (void) __attribute__((interrupt));
+
+extern void sense_init (void);
+extern void sense_start (unsigned char direction, unsigned short lead);
+extern unsigned char sense_rest (void);
+
+#else
+
+#define sense_init()        do { } while(0)
+#define sense_start(D, L)   do { } while(0)
+#define sense_rest()        1
+
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*  Filename:       shutter.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Shutter state machine.  Every (state, input) pair has
+    one byte in a ROM table giving the next state and an action, so a
+    step is a table load and a switch on the action whatever the state.
+
+    The pulse engine times the pulse and its dead time by itself (see
+    pulse.c).  shutter_update only turns its progress into the COIL_OFF
+    and PULSE_DONE inputs, and replays a queued command once the shutter
+    is at rest, for every channel in one pass.  A step depends on nothing
+    but the table, the queue and the pulse engine, so the same code runs
+    unchanged in the host build.
+*/
+
+#include "ShutterJig.h"
+#include "shutter.h"
+#include "stats.h"
+#include "sense.h"
+#include "tune.h"
+#include "adc.h"
+#include "guard.h"
+#include "trace.h"
+
+// Default on and off times (in microseconds)
+#define ON_TIME   100000L
+#define OFF_TIME  300000L
+
+#define SHUTTER_QUEUE_MASK  (SHUTTER_QUEUE_SIZE - 1)
+
+// Actions, in the high nibble of a table entry.
+#define ACT_NONE    0x00
+#define ACT_OPEN    0x10                // start the open pulse
+#define ACT_CLOSE   0x20                // start the close pulse
+#define ACT_QUEUE   0x30                // keep the command for later
+#define ACT_SKIP    0x40                // command not needed, already there
+#define ACT_REST    0x50                // pulse and dead time are over
+
+#define T(NEXT, ACT)    (SHUTTER_##NEXT | ACT_##ACT)
+
+static const unsigned char shutter_table[SHUTTER_STATES][SHUTTER_INPUTS] =
+{
+  //                  CMD_OPEN                CMD_CLOSE                 COIL_OFF                PULSE_DONE
+  /* IDLE        */ { T(DRIVE_OPEN, OPEN),    T(DRIVE_CLOSE, CLOSE),    T(IDLE, NONE),          T(IDLE, NONE) },
+  /* DRIVE_OPEN  */ { T(DRIVE_OPEN, QUEUE),   T(DRIVE_OPEN, QUEUE),     T(DEAD_OPEN, NONE),     T(OPENED, REST) },
+  /* DEAD_OPEN   */ { T(DEAD_OPEN, QUEUE),    T(DEAD_OPEN, QUEUE),      T(DEAD_OPEN, NONE),     T(OPENED, REST) },
+  /* OPENED      */ { T(OPENED, SKIP),        T(DRIVE_CLOSE, CLOSE),    T(OPENED, NONE),        T(OPENED, NONE) },
+  /* DRIVE_CLOSE */ { T(DRIVE_CLOSE, QUEUE),  T(DRIVE_CLOSE, QUEUE),    T(DEAD_CLOSE, NONE),    T(CLOSED, REST) },
+  /* DEAD_CLOSE  */ { T(DEAD_CLOSE, QUEUE),   T(DEAD_CLOSE, QUEUE),     T(DEAD_CLOSE, NONE),    T(CLOSED, REST) },
+  /* CLOSED      */ { T(DRIVE_OPEN, OPEN),    T(CLOSED, SKIP),          T(CLOSED, NONE),        T(CLOSED, NONE) }
+};
+
+// Two letter names for the LCD: position, then > while driving or .
+// during the dead time.
+static const char * const shutter_names[SHUTTER_STATES] =
+{
+  "--", "O>", "O.", "OP", "C>", "C.", "CL"
+};
+
+shutter_t shutters[SHUTTER_CHANNELS];
+
+void shutter_init(void)
+{
+  shutter_t *sh;
+
+  for(sh = shutters; sh < shutters + SHUTTER_CHANNELS; sh++)
+  {
+    sh->state = SHUTTER_IDLE;
+    sh->queue_head = 0;
+    sh->queue_tail = 0;
+    sh->queue_drops = 0;
+    sh->fault = 0;
+    sh->on_us = ON_TIME;
+    sh->dead_us = OFF_TIME;
+  }
+}
+
+// Start a pulse.  Returns 0 if the pulse engine is still busy, which
+// it should never be with the shutter at rest, so that is a fault, or
+// if the supervisor has stopped it.
+static unsigned char shutter_start(unsigned char ch, unsigned char direction)
+{
+  unsigned long on_us, dead_us;
+
+  on_us = shutters[ch].on_us;
+  dead_us = shutters[ch].dead_us;
+  if(ch == 0)
+    tune_times(direction, &on_us, &dead_us);
+  if(!shutter_pulse(ch, direction, on_us, dead_us))
+  {
+    shutters[ch].fault |= guard.fault != GUARD_OK ? SHUTTER_FAULT_GUARD
+                                                  : SHUTTER_FAULT_START;
+    return 0;
+  }
+  adc_start(ch, direction);
+
+  // The latency figures are for the channel 0 buttons, and only channel
+  // 0 has the end-of-travel sensors.
+  if(ch == 0)
+  {
+    stats_coil_on(pulse_leading_edge(0));
+    sense_start(direction, pulse_leading_edge(0));
+  }
+  TRACE((direction == PULSE_OPEN ? TRACE_OPEN : TRACE_CLOSE) + 4 * ch);
+  return 1;
+}
+
+// Put a command back at the front of the queue, to be given again
+// first.  Returns 0 if the queue is full.
+static unsigned char shutter_retry(shutter_t *sh, unsigned char cmd)
+{
+  unsigned char tail;
+
+  tail = (sh->queue_tail - 1) & SHUTTER_QUEUE_MASK;
+  if(tail == sh->queue_head)
+    return 0;
+  sh->queue[tail] = cmd;
+  sh->queue_tail = tail;
+  return 1;
+}
+
+// Take one step of the state machine of a channel.
+static void shutter_step(unsigned char ch, unsigned char input)
+{
+  shutter_t *sh;
+  unsigned char entry, next, direction;
+
+  sh = &shutters[ch];
+  entry = shutter_table[sh->state][input];
+  next = entry & 0x0F;
+  switch(entry & 0xF0)
+  {
+    case ACT_OPEN:
+      if(!shutter_start(ch, PULSE_OPEN))
+        return;
+      break;
+
+    case ACT_CLOSE:
+      if(!shutter_start(ch, PULSE_CLOSE))
+        return;
+      break;
+
+    case ACT_QUEUE:
+      if(((sh->queue_head + 1) & SHUTTER_QUEUE_MASK) == sh->queue_tail)
+      {
+        sh->queue_drops++;
+        break;
+      }
+      sh->queue[sh->queue_head] = input;
+      sh->queue_head = (sh->queue_head + 1) & SHUTTER_QUEUE_MASK;
+      break;
+
+    case ACT_SKIP:
+      if(ch == 0)
+        stats_press_cancel();
+      break;
+
+    case ACT_REST:
+      // A trip of the supervisor or a stall leaves the position unknown.
+      // After a miss with tuned times the command is given again, with
+      // longer ones.
+      if(guard.fault != GUARD_OK)
+      {
+        sh->fault |= SHUTTER_FAULT_GUARD;
+        next = SHUTTER_IDLE;
+        break;
+      }
+      if(ch == 0)
+      {
+        direction = next == SHUTTER_OPENED ? PULSE_OPEN : PULSE_CLOSE;
+        if(!sense_rest())
+        {
+          if(!tune_miss(direction)
+             || !shutter_retry(sh, direction == PULSE_OPEN ? SHUTTER_CMD_OPEN
+                                                           : SHUTTER_CMD_CLOSE))
+            sh->fault |= SHUTTER_FAULT_STALL;
+          next = SHUTTER_IDLE;
+          break;
+        }
+        tune_done(direction);
+      }
+      TRACE((next == SHUTTER_OPENED ? TRACE_OPENED : TRACE_CLOSED) + 4 * ch);
+      break;
+  }
+  sh->state = next;
+}
+
+// Give an open or close command to a channel.
+void shutter_command(unsigned char ch, unsigned char cmd)
+{
+  shutter_step(ch, cmd);
+}
+
+// Follow the pulse engine on every channel.  This runs on every tick
+// and whenever a pulse or a dead time ends.
+void shutter_update(void)
+{
+  shutter_t *sh;
+  unsigned char ch, cmd;
+
+  for(ch = 0, sh = shutters; ch < SHUTTER_CHANNELS; ch++, sh++)
+  {
+    if(!pulse_busy(ch))
+      shutter_step(ch, SHUTTER_PULSE_DONE);
+    else if(!pulse_driving(ch))
+      shutter_step(ch, SHUTTER_COIL_OFF);
+
+    // Once at rest, carry out the oldest queued command.
+    if(sh->queue_tail != sh->queue_head && SHUTTER_AT_REST(sh->state))
+    {
+      cmd = sh->queue[sh->queue_tail];
+      sh->queue_tail = (sh->queue_tail + 1) & SHUTTER_QUEUE_MASK;
+      shutter_step(ch, cmd);
+    }
+  }
+}
+
+// Return != 0 when a channel is at rest with no command queued, so a
+// new command starts a pulse at once.
+unsigned char shutter_ready(unsigned char ch)
+{
+  return SHUTTER_AT_REST(shutters[ch].state)
+    && shutters[ch].queue_tail == shutters[ch].queue_head;
+}
+
+const char *shutter_state_name(unsigned char state)
+{
+  return shutter_names[state];
+}
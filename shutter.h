@@ -0,0 +1,70 @@
+/*  Filename:       shutter.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the shutter state machine.
+    Open and close commands and the progress of the pulse engine are the
+    inputs of a single transition table.  A command that comes while a
+    pulse or its dead time is running is queued and carried out once the
+    shutter is at rest.  Each channel (one shutter on one H-bridge) has
+    its own state, queue and pulse times.
+*/
+
+#ifndef _SHUTTER_H
+#define _SHUTTER_H
+
+/* States.  */
+#define SHUTTER_IDLE        0           /* position unknown */
+#define SHUTTER_DRIVE_OPEN  1           /* open pulse on */
+#define SHUTTER_DEAD_OPEN   2           /* dead time after the open pulse */
+#define SHUTTER_OPENED      3
+#define SHUTTER_DRIVE_CLOSE 4           /* close pulse on */
+#define SHUTTER_DEAD_CLOSE  5           /* dead time after the close pulse */
+#define SHUTTER_CLOSED      6
+#define SHUTTER_STATES      7
+
+/* Inputs.  */
+#define SHUTTER_CMD_OPEN    0
+#define SHUTTER_CMD_CLOSE   1
+#define SHUTTER_COIL_OFF    2           /* the pulse ended */
+#define SHUTTER_PULSE_DONE  3           /* the dead time ended */
+#define SHUTTER_INPUTS      4
+
+/* Number of queued commands (must be a power of 2).  */
+#define SHUTTER_QUEUE_SIZE  4
+
+#define SHUTTER_CHANNELS    PULSE_CHANNELS
+
+/* Fault bits.  */
+#define SHUTTER_FAULT_START 0x01        /* the pulse engine refused a pulse */
+#define SHUTTER_FAULT_STALL 0x02        /* did not get to the end (sense.h) */
+#define SHUTTER_FAULT_GUARD 0x04        /* stopped by the supervisor (guard.h) */
+
+/* States in which the shutter is at rest.  */
+#define SHUTTER_AT_REST(S)  ((S) == SHUTTER_IDLE || (S) == SHUTTER_OPENED \
+                             || (S) == SHUTTER_CLOSED)
+
+/*! State of one channel.  */
+struct shutter
+{
+  unsigned char state;
+  unsigned char queue_head;
+  unsigned char queue_tail;
+  unsigned char queue[SHUTTER_QUEUE_SIZE];
+  unsigned short queue_drops;           /* commands lost, queue full */
+  unsigned char fault;                  /* fault bits, until cleared */
+  unsigned long on_us;                  /* pulse and dead times in use, */
+  unsigned long dead_us;                /* from the next pulse on */
+};
+typedef struct shutter shutter_t;
+
+extern shutter_t shutters[SHUTTER_CHANNELS];
+
+extern void shutter_init (void);
+extern void shutter_command (unsigned char ch, unsigned char cmd);
+extern void shutter_update (void);
+extern unsigned char shutter_ready (unsigned char ch);
+extern const char *shutter_state_name (unsigned char state);
+
+#endif
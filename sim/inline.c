@@ -0,0 +1,15 @@
+/*  Filename:       inline.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Out of line copies of the "extern inline" functions of
+    the Gel headers for the host simulation build.  The HC11 build always
+    inlines them; the host compiler is free not to, and then needs a real
+    definition to link against.
+*/
+
+#define inline
+
+#include <ports.h>
+#include <sio.h>
@@ -0,0 +1,22 @@
+/*  Filename:       interrupts.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Host simulation wrapper for include/interrupts.h.  The
+    vector definitions are taken from the real header, but the handlers
+    are recorded by the simulator (sim/sim.c) instead of being written
+    into the bootstrap pseudo-vectors below 0x0100.
+*/
+
+#ifndef SIM_INTERRUPTS_H
+#define SIM_INTERRUPTS_H
+
+#define set_interrupt_handler gel_set_interrupt_handler
+#include_next <interrupts.h>
+#undef set_interrupt_handler
+
+extern void
+set_interrupt_handler (interrupt_vector_id id, interrupt_t handler);
+
+#endif
@@ -0,0 +1,278 @@
+/*  Filename:       jigctl.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Command line client for the binary serial protocol,
+    built on jigproto.c.  Channels are numbered from 1, as at the prompt.
+
+    Usage: jigctl [-w ms] [-b baud] line command [arguments]
+      ping
+      open <ch> | close <ch>
+      pulse <ch>|all <on_us> <dead_us>
+      counters <ch>
+      stats rti|coil|open|close
+      travel                        last travel times (make SENSE=1 only)
+      pulses <ch>                   last coil pulse, from the current sense
+      guard [clear]                 supervisor fault, then clear it
+      telemetry <ticks> [frames]    print frames (10 by default) and the
+                                    pulses in between, then stop
+      baud <rate>                   change the rate of the jig
+    -w sets how long to wait for each reply (1000ms by default), and -b
+    the rate the jig is at (9600 by default).  The jig goes back to 9600
+    at reset.
+
+    To try it without a jig, run the host build with "ShutterJig-host -s"
+    and give the pseudo terminal it prints as the line.  The simulation
+    is slower than real time, so allow a longer wait.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jigproto.h"
+
+/* State names, as on the LCD (see shutter.c).  */
+static const char *const ctl_states[] =
+{
+  "--", "O>", "O.", "OP", "C>", "C.", "CL"
+};
+
+static const char *const ctl_endure[] =
+{
+  "running", "stopped", "done", "fault"
+};
+
+static const char *const ctl_travel[] =
+{
+  "-", "done", "stall"
+};
+
+static const char *const ctl_guard[] =
+{
+  "ok", "overlap", "on time"
+};
+
+static int ctl_wait = 1000;
+
+static void ctl_usage(void)
+{
+  fprintf(stderr, "usage: jigctl [-w ms] [-b baud] line command [arguments]\n"
+          "  ping\n"
+          "  open <ch> | close <ch>\n"
+          "  pulse <ch>|all <on_us> <dead_us>\n"
+          "  counters <ch>\n"
+          "  stats rti|coil|open|close\n"
+          "  travel\n"
+          "  pulses <ch>\n"
+          "  guard [clear]\n"
+          "  telemetry <ticks> [frames]\n"
+          "  baud <rate>\n");
+  exit(2);
+}
+
+static const char *ctl_state(unsigned char state)
+{
+  return state < sizeof (ctl_states) / sizeof (ctl_states[0])
+    ? ctl_states[state] : "??";
+}
+
+// Print a pulse record (PROTO_GET_PULSE reply or PROTO_EVENT_PULSE).
+static void ctl_pulse(const unsigned char *d)
+{
+  if(d[1] == 0)
+  {
+    printf("channel %d no pulse yet\n", d[0] + 1);
+    return;
+  }
+  printf("channel %d #%u %s n=%u peak %u mA mean %u mA supply %u mV %lu mJ\n",
+         d[0] + 1, d[1], d[2] == 1 ? "open" : "close", jig_get16(&d[3]),
+         jig_get16(&d[5]), jig_get16(&d[7]), jig_get16(&d[9]),
+         jig_get32(&d[11]));
+}
+
+// Parse a 1-based channel into the 0-based one of the protocol.
+static unsigned char ctl_channel(const char *arg)
+{
+  int ch;
+
+  if(strcmp(arg, "all") == 0)
+    return 0xFF;
+  ch = atoi(arg);
+  if(ch < 1 || ch > 255)
+    ctl_usage();
+  return ch - 1;
+}
+
+// Send a request and wait for the reply; exit on anything else.
+static void ctl_call(int fd, unsigned char op, const unsigned char *data,
+                     unsigned char len, struct jig_frame *reply)
+{
+  int r;
+
+  r = jig_call(fd, op, data, len, reply, ctl_wait);
+  if(r == JIG_OK)
+    return;
+  if(r == JIG_NAK)
+    fprintf(stderr, "jigctl: request 0x%02x refused, error %d\n",
+            reply->data[0], reply->data[1]);
+  else if(r == JIG_TIMEOUT)
+    fprintf(stderr, "jigctl: no reply\n");
+  else
+    perror("jigctl");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  struct jig_frame reply;
+  unsigned char req[PROTO_MAX_PAYLOAD];
+  const char *cmd;
+  unsigned long baud;
+  int fd, opt, frames, ch, r;
+
+  baud = 9600;
+  while((opt = getopt(argc, argv, "w:b:")) != -1)
+  {
+    if(opt == 'w')
+      ctl_wait = atoi(optarg);
+    else if(opt == 'b')
+      baud = strtoul(optarg, 0, 10);
+    else
+      ctl_usage();
+  }
+  if(argc - optind < 2)
+    ctl_usage();
+
+  fd = jig_open(argv[optind]);
+  if(fd < 0 || jig_set_baud(fd, baud) != JIG_OK)
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+  cmd = argv[optind + 1];
+  argv += optind + 2;
+  argc -= optind + 2;
+
+  if(strcmp(cmd, "ping") == 0 && argc == 0)
+  {
+    ctl_call(fd, PROTO_PING, req, 0, &reply);
+    printf("protocol %d, %d channels\n", reply.data[0], reply.data[1]);
+  }
+  else if((strcmp(cmd, "open") == 0 || strcmp(cmd, "close") == 0) && argc == 1)
+  {
+    req[0] = ctl_channel(argv[0]);
+    ctl_call(fd, cmd[0] == 'o' ? PROTO_OPEN : PROTO_CLOSE, req, 1, &reply);
+    printf("channel %d %s\n", reply.data[0] + 1, ctl_state(reply.data[1]));
+  }
+  else if(strcmp(cmd, "pulse") == 0 && argc == 3)
+  {
+    req[0] = ctl_channel(argv[0]);
+    jig_put32(jig_put32(&req[1], strtoul(argv[1], 0, 0)),
+              strtoul(argv[2], 0, 0));
+    ctl_call(fd, PROTO_SET_PULSE, req, 9, &reply);
+  }
+  else if(strcmp(cmd, "counters") == 0 && argc == 1)
+  {
+    req[0] = ctl_channel(argv[0]);
+    ctl_call(fd, PROTO_GET_COUNTERS, req, 1, &reply);
+    printf("channel %d %s fault 0x%02x endurance %s cycles %lu total %lu"
+           " queue drops %u\n", reply.data[0] + 1, ctl_state(reply.data[1]),
+           reply.data[2], reply.data[3] < 4 ? ctl_endure[reply.data[3]] : "??",
+           jig_get32(&reply.data[4]), jig_get32(&reply.data[8]),
+           jig_get16(&reply.data[12]));
+  }
+  else if(strcmp(cmd, "stats") == 0 && argc == 1)
+  {
+    if(strcmp(argv[0], "rti") == 0)
+      req[0] = PROTO_STATS_RTI;
+    else if(strcmp(argv[0], "coil") == 0)
+      req[0] = PROTO_STATS_COIL;
+    else if(strcmp(argv[0], "open") == 0)
+      req[0] = PROTO_STATS_OPEN;
+    else if(strcmp(argv[0], "close") == 0)
+      req[0] = PROTO_STATS_CLOSE;
+    else
+      ctl_usage();
+    ctl_call(fd, PROTO_GET_STATS, req, 1, &reply);
+    printf("%s n=%lu min %u avg %u max %u ticks (8us)\n", argv[0],
+           jig_get32(&reply.data[1]), jig_get16(&reply.data[5]),
+           jig_get16(&reply.data[7]), jig_get16(&reply.data[9]));
+  }
+  else if(strcmp(cmd, "travel") == 0 && argc == 0)
+  {
+    ctl_call(fd, PROTO_GET_TRAVEL, req, 0, &reply);
+    printf("open %u us %s, close %u us %s, %u stalls, %u cut short\n",
+           jig_get16(reply.data) * 8,
+           reply.data[4] < 3 ? ctl_travel[reply.data[4]] : "??",
+           jig_get16(&reply.data[2]) * 8,
+           reply.data[5] < 3 ? ctl_travel[reply.data[5]] : "??",
+           jig_get16(&reply.data[6]), jig_get16(&reply.data[8]));
+  }
+  else if(strcmp(cmd, "pulses") == 0 && argc == 1)
+  {
+    req[0] = ctl_channel(argv[0]);
+    ctl_call(fd, PROTO_GET_PULSE, req, 1, &reply);
+    ctl_pulse(reply.data);
+  }
+  else if(strcmp(cmd, "guard") == 0
+          && (argc == 0 || (argc == 1 && strcmp(argv[0], "clear") == 0)))
+  {
+    req[0] = argc;
+    ctl_call(fd, PROTO_GUARD, req, 1, &reply);
+    printf("%s", reply.data[0] < 3 ? ctl_guard[reply.data[0]] : "??");
+    if(reply.data[0])
+      printf(" on channel %d", reply.data[1] + 1);
+    printf(", %u faults%s\n", jig_get16(&reply.data[2]),
+           argc && reply.data[0] ? ", cleared" : "");
+  }
+  else if(strcmp(cmd, "telemetry") == 0 && (argc == 1 || argc == 2))
+  {
+    req[0] = atoi(argv[0]) >> 8;
+    req[1] = atoi(argv[0]);
+    frames = argc == 2 ? atoi(argv[1]) : 10;
+    ctl_call(fd, PROTO_TELEMETRY, req, 2, &reply);
+    while(frames-- > 0)
+    {
+      if(jig_recv(fd, &reply, ctl_wait) != JIG_OK)
+      {
+        fprintf(stderr, "jigctl: telemetry stopped\n");
+        break;
+      }
+      if(reply.op == PROTO_EVENT_PULSE)
+      {
+        printf("%10s  ", "pulse");
+        ctl_pulse(reply.data);
+      }
+      if(reply.op != PROTO_EVENT)
+      {
+        frames++;
+        continue;
+      }
+      printf("%10lu", jig_get32(reply.data));
+      for(ch = 0; 4 + 5 * ch + 5 <= reply.len; ch++)
+        printf("  %d:%s %lu", ch + 1, ctl_state(reply.data[4 + 5 * ch]),
+               jig_get32(&reply.data[5 + 5 * ch]));
+      printf("\n");
+    }
+    req[0] = req[1] = 0;
+    ctl_call(fd, PROTO_TELEMETRY, req, 2, &reply);
+  }
+  else if(strcmp(cmd, "baud") == 0 && argc == 1)
+  {
+    r = jig_change_baud(fd, strtoul(argv[0], 0, 10), ctl_wait);
+    if(r != JIG_OK)
+    {
+      fprintf(stderr, "jigctl: rate not changed\n");
+      return 1;
+    }
+    printf("baud rate changed\n");
+  }
+  else
+    ctl_usage();
+
+  close(fd);
+  return 0;
+}
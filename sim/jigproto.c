@@ -0,0 +1,265 @@
+/*  Filename:       jigproto.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Host library for the binary serial protocol of the
+    jig.  The line also carries the text of the prompt, so the receiver
+    skips whatever comes before PROTO_SYNC, and starts looking again
+    after a frame with a bad CRC.  Telemetry frames that arrive while
+    jig_call waits for its reply are dropped.
+
+    Most rates of the jig (125000 baud at 8MHz for instance) are not
+    standard ones, so the line is set up through termios2 with BOTHER,
+    which takes any rate the serial adapter can make.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jigproto.h"
+
+unsigned long jig_skipped;
+unsigned long jig_bad_frames;
+
+// Set the line to a rate, 8 bits, no parity, raw.  Once the line is
+// raw, a pseudo terminal takes any rate, so that is not checked.
+int jig_set_baud(int fd, unsigned long baud)
+{
+  struct termios2 tio;
+
+  if(ioctl(fd, TCGETS2, &tio) < 0)
+    return JIG_ERROR;
+
+  tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR
+                   | ICRNL | IXON | IXOFF);
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CBAUD | (CBAUD << IBSHIFT));
+  tio.c_cflag |= CS8 | CLOCAL | CREAD | BOTHER | (BOTHER << IBSHIFT);
+  tio.c_ispeed = baud;
+  tio.c_ospeed = baud;
+  if(ioctl(fd, TCSETS2, &tio) < 0)
+    return JIG_ERROR;
+  return JIG_OK;
+}
+
+// Open the serial line at the reset rate of the jig (9600 baud).
+int jig_open(const char *path)
+{
+  int fd;
+
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if(fd < 0)
+    return -1;
+  jig_set_baud(fd, 9600);
+  return fd;
+}
+
+int jig_send(int fd, unsigned char op, const unsigned char *data,
+             unsigned char len)
+{
+  unsigned char buf[PROTO_MAX_PAYLOAD + 4];
+  unsigned char crc;
+  int i, n, done;
+
+  if(len > PROTO_MAX_PAYLOAD)
+  {
+    errno = EINVAL;
+    return JIG_ERROR;
+  }
+
+  buf[0] = PROTO_SYNC;
+  buf[1] = len;
+  buf[2] = op;
+  crc = proto_crc8(proto_crc8(0, len), op);
+  for(i = 0; i < len; i++)
+  {
+    buf[3 + i] = data[i];
+    crc = proto_crc8(crc, data[i]);
+  }
+  buf[3 + len] = crc;
+
+  for(done = 0; done < len + 4; done += n)
+  {
+    n = write(fd, buf + done, len + 4 - done);
+    if(n < 0 && errno != EINTR)
+      return JIG_ERROR;
+    if(n < 0)
+      n = 0;
+  }
+  return JIG_OK;
+}
+
+static long jig_ms(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+// Read one byte within the time left.
+static int jig_byte(int fd, unsigned char *c, long deadline)
+{
+  struct pollfd pfd;
+  long left;
+  int n;
+
+  while(1)
+  {
+    left = deadline - jig_ms();
+    if(left < 0)
+      return JIG_TIMEOUT;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    n = poll(&pfd, 1, (int) left);
+    if(n < 0 && errno != EINTR)
+      return JIG_ERROR;
+    if(n <= 0)
+      continue;
+
+    n = read(fd, c, 1);
+    if(n == 1)
+      return JIG_OK;
+    if(n < 0 && errno != EINTR && errno != EAGAIN)
+      return JIG_ERROR;
+  }
+}
+
+// Receive the next good frame.  A NAK frame gives JIG_NAK.
+int jig_recv(int fd, struct jig_frame *frame, int timeout_ms)
+{
+  unsigned char c, crc;
+  long deadline;
+  int r, i;
+
+  deadline = jig_ms() + timeout_ms;
+  while(1)
+  {
+    if((r = jig_byte(fd, &c, deadline)) != JIG_OK)
+      return r;
+    if(c != PROTO_SYNC)
+    {
+      jig_skipped++;
+      continue;
+    }
+
+    if((r = jig_byte(fd, &frame->len, deadline)) != JIG_OK)
+      return r;
+    if(frame->len > PROTO_MAX_PAYLOAD)
+    {
+      jig_bad_frames++;
+      continue;
+    }
+    if((r = jig_byte(fd, &frame->op, deadline)) != JIG_OK)
+      return r;
+    crc = proto_crc8(proto_crc8(0, frame->len), frame->op);
+    for(i = 0; i < frame->len; i++)
+    {
+      if((r = jig_byte(fd, &frame->data[i], deadline)) != JIG_OK)
+        return r;
+      crc = proto_crc8(crc, frame->data[i]);
+    }
+    if((r = jig_byte(fd, &c, deadline)) != JIG_OK)
+      return r;
+    if(c != crc)
+    {
+      jig_bad_frames++;
+      continue;
+    }
+    return frame->op == PROTO_NAK ? JIG_NAK : JIG_OK;
+  }
+}
+
+// Send a request and wait for its reply.
+int jig_call(int fd, unsigned char op, const unsigned char *data,
+             unsigned char len, struct jig_frame *reply, int timeout_ms)
+{
+  long deadline;
+  int r;
+
+  if((r = jig_send(fd, op, data, len)) != JIG_OK)
+    return r;
+
+  deadline = jig_ms() + timeout_ms;
+  while(1)
+  {
+    r = jig_recv(fd, reply, (int) (deadline - jig_ms()));
+    // A NAK names the opcode, or 0 when the length was bad.
+    if(r == JIG_NAK && reply->len == 2 && reply->data[0] != op
+       && reply->data[0] != 0)
+      continue;
+    if(r != JIG_OK || reply->op == (op | PROTO_REPLY))
+      return r;
+  }
+}
+
+// Move the jig and the line to a new rate.  The jig answers at the old
+// rate with the rate it will use, then both change, and the jig keeps
+// the new rate once a confirm gets through.  If none does, the line
+// goes back to the old rate along with the jig.
+int jig_change_baud(int fd, unsigned long baud, int timeout_ms)
+{
+  struct termios2 tio;
+  struct jig_frame reply;
+  unsigned char req[4];
+  unsigned long old;
+  long deadline;
+  int r;
+
+  if(ioctl(fd, TCGETS2, &tio) < 0)
+    return JIG_ERROR;
+  old = tio.c_ospeed;
+
+  jig_put32(req, baud);
+  if((r = jig_call(fd, PROTO_SET_BAUD, req, 4, &reply, timeout_ms)) != JIG_OK)
+    return r;
+  baud = jig_get32(reply.data);
+  ioctl(fd, TCSBRK, 1);
+  if(jig_set_baud(fd, baud) != JIG_OK)
+    return JIG_ERROR;
+
+  // The jig changes once its transmitter is empty; retry until then,
+  // every tenth of the wait.  A refusal that gets through at the new
+  // rate means an earlier confirm did, and only its reply was lost.
+  deadline = jig_ms() + timeout_ms;
+  do
+  {
+    ioctl(fd, TCFLSH, TCIFLUSH);
+    r = jig_call(fd, PROTO_BAUD_CONFIRM, req, 0, &reply, timeout_ms / 10);
+    if(r == JIG_OK && jig_get32(reply.data) == baud)
+      return JIG_OK;
+    if(r == JIG_NAK && reply.data[1] == PROTO_ERR_STATE)
+      return JIG_OK;
+  }
+  while(r != JIG_ERROR && jig_ms() < deadline);
+
+  jig_set_baud(fd, old);
+  return r == JIG_ERROR ? r : JIG_TIMEOUT;
+}
+
+unsigned short jig_get16(const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+unsigned long jig_get32(const unsigned char *p)
+{
+  return ((unsigned long) jig_get16(p) << 16) | jig_get16(p + 2);
+}
+
+unsigned char *jig_put32(unsigned char *p, unsigned long val)
+{
+  *p++ = val >> 24;
+  *p++ = val >> 16;
+  *p++ = val >> 8;
+  *p++ = val;
+  return p;
+}
@@ -0,0 +1,49 @@
+/*  Filename:       jigproto.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Host library for the binary serial protocol of the
+    jig (see proto.h): opening the serial line, and sending and
+    receiving frames.  The board may be a real jig on a serial port or
+    the host simulator on its pseudo terminal (ShutterJig-host -s).
+*/
+
+#ifndef _JIGPROTO_H
+#define _JIGPROTO_H
+
+#include "proto.h"
+
+/*! A received frame.  */
+struct jig_frame
+{
+  unsigned char op;
+  unsigned char len;
+  unsigned char data[PROTO_MAX_PAYLOAD];
+};
+
+/* Results of jig_recv and jig_call.  */
+#define JIG_OK          1
+#define JIG_TIMEOUT     0
+#define JIG_ERROR       (-1)            /* see errno */
+#define JIG_NAK         (-2)            /* the frame holds the NAK */
+
+extern int jig_open (const char *path);
+extern int jig_set_baud (int fd, unsigned long baud);
+extern int jig_change_baud (int fd, unsigned long baud, int timeout_ms);
+extern int jig_send (int fd, unsigned char op, const unsigned char *data,
+                     unsigned char len);
+extern int jig_recv (int fd, struct jig_frame *frame, int timeout_ms);
+extern int jig_call (int fd, unsigned char op, const unsigned char *data,
+                     unsigned char len, struct jig_frame *reply,
+                     int timeout_ms);
+
+extern unsigned short jig_get16 (const unsigned char *p);
+extern unsigned long jig_get32 (const unsigned char *p);
+extern unsigned char *jig_put32 (unsigned char *p, unsigned long val);
+
+/* Bytes skipped while looking for a frame, and frames with a bad CRC.  */
+extern unsigned long jig_skipped;
+extern unsigned long jig_bad_frames;
+
+#endif
@@ -0,0 +1,333 @@
+/*  Filename:       jigtest.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Loopback test of the binary serial protocol (make
+    prototest).  It starts the host build on a pseudo terminal
+    (ShutterJig-host -s), sends every opcode through jigproto.c and
+    checks each reply, along with the NAKs for a bad length, a bad CRC,
+    an unknown opcode and bad arguments, and telemetry frames that come
+    in while a call waits for its reply.
+
+    Usage: jigtest path-to-ShutterJig-host
+
+    Each failed check is printed; the exit status is 1 if any failed.
+    Expected states and limits are those of shutter.h and pulse.h.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "jigproto.h"
+
+/* Each call may take a while, since the simulation is slower than real
+   time.  */
+#define TEST_WAIT_MS        20000
+
+#define TEST_CHANNELS       4           /* PULSE_CHANNELS */
+#define TEST_PULSE_CHANNELS 3           /* ADC_CHANNELS */
+#define TEST_DRIVE_OPEN     1           /* SHUTTER_DRIVE_OPEN */
+#define TEST_DRIVE_CLOSE    4           /* SHUTTER_DRIVE_CLOSE */
+
+static int test_fd;
+static int test_checks;
+static int test_failed;
+
+#define CHECK(COND) test_check((COND), #COND, __LINE__)
+
+static void test_check(int ok, const char *what, int line)
+{
+  test_checks++;
+  if(ok)
+    return;
+  test_failed++;
+  printf("jigtest.c:%d: failed: %s\n", line, what);
+}
+
+// Start the host build on a pseudo terminal and open it.  The name of
+// the terminal comes on its standard error.
+static pid_t test_start(const char *host)
+{
+  char line[256], pty[128];
+  FILE *err;
+  pid_t pid;
+  int fds[2];
+
+  if(pipe(fds) < 0)
+  {
+    perror("jigtest");
+    exit(2);
+  }
+  pid = fork();
+  if(pid == 0)
+  {
+    dup2(fds[1], 2);
+    close(fds[0]);
+    if(freopen("/dev/null", "w", stdout) == 0)
+      _exit(127);
+    execl(host, host, "-s", "-t", "3600000", (char *) 0);
+    _exit(127);
+  }
+  close(fds[1]);
+
+  err = fdopen(fds[0], "r");
+  if(pid < 0 || err == 0 || fgets(line, sizeof (line), err) == 0
+     || sscanf(line, "sim: serial line on %127s", pty) != 1)
+  {
+    fprintf(stderr, "jigtest: %s did not start\n", host);
+    exit(2);
+  }
+
+  test_fd = jig_open(pty);
+  if(test_fd < 0)
+  {
+    perror(pty);
+    kill(pid, SIGTERM);
+    exit(2);
+  }
+  return pid;
+}
+
+// Send a request; returns the result of jig_call.
+static int test_call(unsigned char op, const unsigned char *data,
+                     unsigned char len, struct jig_frame *reply)
+{
+  return jig_call(test_fd, op, data, len, reply, TEST_WAIT_MS);
+}
+
+// Check that a request is refused with an error code.
+static void test_nak(unsigned char op, const unsigned char *data,
+                     unsigned char len, unsigned char error, int line)
+{
+  struct jig_frame reply;
+  int r;
+
+  r = test_call(op, data, len, &reply);
+  test_check(r == JIG_NAK && reply.len == 2 && reply.data[0] == op
+             && reply.data[1] == error, "NAK with the expected error", line);
+}
+
+// Write raw bytes, for frames jig_send would not make.
+static void test_raw(const unsigned char *bytes, int len)
+{
+  if(write(test_fd, bytes, len) != len)
+    perror("jigtest");
+}
+
+static void test_requests(void)
+{
+  struct jig_frame reply;
+  unsigned char req[PROTO_MAX_PAYLOAD];
+
+  CHECK(test_call(PROTO_PING, req, 0, &reply) == JIG_OK);
+  CHECK(reply.len == 2 && reply.data[0] == PROTO_VERSION
+        && reply.data[1] == TEST_CHANNELS);
+
+  // Short pulses, so the ones below are soon over.
+  req[0] = 0xFF;
+  jig_put32(jig_put32(&req[1], 5000), 20000);
+  CHECK(test_call(PROTO_SET_PULSE, req, 9, &reply) == JIG_OK);
+  CHECK(reply.len == 0);
+  jig_put32(&req[1], 100);                      // below PULSE_MIN_US
+  test_nak(PROTO_SET_PULSE, req, 9, PROTO_ERR_ARG, __LINE__);
+  req[0] = TEST_CHANNELS;
+  jig_put32(&req[1], 5000);
+  test_nak(PROTO_SET_PULSE, req, 9, PROTO_ERR_ARG, __LINE__);
+
+  req[0] = 0;
+  CHECK(test_call(PROTO_OPEN, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 2 && reply.data[0] == 0
+        && reply.data[1] == TEST_DRIVE_OPEN);
+  req[0] = 1;
+  CHECK(test_call(PROTO_CLOSE, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 2 && reply.data[0] == 1
+        && reply.data[1] == TEST_DRIVE_CLOSE);
+  req[0] = TEST_CHANNELS;
+  test_nak(PROTO_OPEN, req, 1, PROTO_ERR_ARG, __LINE__);
+  req[0] = 0;
+  test_nak(PROTO_CLOSE, req, 2, PROTO_ERR_ARG, __LINE__);
+
+  req[0] = 0;
+  CHECK(test_call(PROTO_GET_COUNTERS, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 14 && reply.data[0] == 0 && reply.data[2] == 0);
+  req[0] = TEST_CHANNELS;
+  test_nak(PROTO_GET_COUNTERS, req, 1, PROTO_ERR_ARG, __LINE__);
+
+  req[0] = PROTO_STATS_RTI;
+  CHECK(test_call(PROTO_GET_STATS, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 11 && reply.data[0] == PROTO_STATS_RTI
+        && jig_get32(&reply.data[1]) > 0
+        && jig_get16(&reply.data[5]) <= jig_get16(&reply.data[7])
+        && jig_get16(&reply.data[7]) <= jig_get16(&reply.data[9]));
+  req[0] = PROTO_STATS_COIL;
+  CHECK(test_call(PROTO_GET_STATS, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 11 && reply.data[0] == PROTO_STATS_COIL);
+  req[0] = PROTO_STATS_CLOSE + 1;
+  test_nak(PROTO_GET_STATS, req, 1, PROTO_ERR_ARG, __LINE__);
+
+  // Only a SENSE=1 build knows the travel times.
+  if(test_call(PROTO_GET_TRAVEL, req, 0, &reply) == JIG_OK)
+    CHECK(reply.len == 10);
+  else
+    CHECK(reply.op == PROTO_NAK && reply.data[0] == PROTO_GET_TRAVEL
+          && reply.data[1] == PROTO_ERR_OPCODE);
+
+  // The open pulse on channel 1 is over by now.
+  req[0] = 0;
+  CHECK(test_call(PROTO_GET_PULSE, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 15 && reply.data[0] == 0 && reply.data[1] >= 1
+        && reply.data[2] == 1 && jig_get16(&reply.data[3]) > 0
+        && jig_get16(&reply.data[5]) >= jig_get16(&reply.data[7]));
+  req[0] = TEST_PULSE_CHANNELS;
+  test_nak(PROTO_GET_PULSE, req, 1, PROTO_ERR_ARG, __LINE__);
+
+  req[0] = 0;
+  CHECK(test_call(PROTO_GUARD, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 4 && reply.data[0] == 0);
+  req[0] = 1;
+  CHECK(test_call(PROTO_GUARD, req, 1, &reply) == JIG_OK);
+  CHECK(reply.len == 4 && reply.data[0] == 0);
+  req[0] = 2;
+  test_nak(PROTO_GUARD, req, 1, PROTO_ERR_ARG, __LINE__);
+}
+
+// Telemetry: periodic frames, a pulse frame, and calls answered in
+// between.
+static void test_telemetry(void)
+{
+  struct jig_frame reply;
+  unsigned char req[4];
+  unsigned long last;
+  int events, pulses, i, r;
+
+  req[0] = 0;
+  req[1] = 5;
+  CHECK(test_call(PROTO_TELEMETRY, req, 2, &reply) == JIG_OK);
+  CHECK(reply.len == 0);
+
+  // Frames come in ahead of the reply; jig_call must skip them.
+  req[0] = 2;
+  CHECK(jig_send(test_fd, PROTO_OPEN, req, 1) == JIG_OK);
+  events = 0;
+  pulses = 0;
+  last = 0;
+  for(i = 0; i < 50; i++)
+  {
+    r = jig_recv(test_fd, &reply, TEST_WAIT_MS);
+    CHECK(r == JIG_OK);
+    if(r != JIG_OK || reply.op == (PROTO_OPEN | PROTO_REPLY))
+      break;
+    if(reply.op == PROTO_EVENT)
+    {
+      CHECK(reply.len == 4 + 5 * TEST_CHANNELS);
+      CHECK(events == 0 || jig_get32(reply.data) > last);
+      last = jig_get32(reply.data);
+      events++;
+    }
+  }
+  CHECK(reply.op == (PROTO_OPEN | PROTO_REPLY) && reply.data[0] == 2
+        && reply.data[1] == TEST_DRIVE_OPEN);
+
+  // The pulse just asked for is reported once over, among the periodic
+  // frames.
+  for(i = 0; i < 50 && (!pulses || events < 2); i++)
+  {
+    r = jig_recv(test_fd, &reply, TEST_WAIT_MS);
+    CHECK(r == JIG_OK);
+    if(r != JIG_OK)
+      break;
+    if(reply.op == PROTO_EVENT)
+      events++;
+    else if(reply.op == PROTO_EVENT_PULSE)
+    {
+      CHECK(reply.len == 15 && reply.data[0] == 2 && reply.data[2] == 1);
+      pulses++;
+    }
+  }
+  CHECK(events >= 2 && pulses == 1);
+
+  CHECK(test_call(PROTO_PING, req, 0, &reply) == JIG_OK);
+  CHECK(reply.op == (PROTO_PING | PROTO_REPLY) && reply.len == 2);
+
+  req[0] = 0x80;
+  req[1] = 0;
+  test_nak(PROTO_TELEMETRY, req, 2, PROTO_ERR_ARG, __LINE__);
+  req[0] = 0;
+  CHECK(test_call(PROTO_TELEMETRY, req, 2, &reply) == JIG_OK);
+  test_nak(PROTO_TELEMETRY, req, 1, PROTO_ERR_ARG, __LINE__);
+}
+
+// Frames the parser must refuse.
+static void test_bad_frames(void)
+{
+  static const unsigned char too_long[] = { PROTO_SYNC, PROTO_MAX_PAYLOAD + 1 };
+  struct jig_frame reply;
+  unsigned char frame[4], req[4];
+  int r;
+
+  test_raw(too_long, sizeof (too_long));
+  r = jig_recv(test_fd, &reply, TEST_WAIT_MS);
+  CHECK(r == JIG_NAK && reply.len == 2 && reply.data[0] == 0
+        && reply.data[1] == PROTO_ERR_LENGTH);
+
+  frame[0] = PROTO_SYNC;
+  frame[1] = 0;
+  frame[2] = PROTO_PING;
+  frame[3] = proto_crc8(proto_crc8(0, 0), PROTO_PING) ^ 0x55;
+  test_raw(frame, sizeof (frame));
+  r = jig_recv(test_fd, &reply, TEST_WAIT_MS);
+  CHECK(r == JIG_NAK && reply.len == 2 && reply.data[0] == PROTO_PING
+        && reply.data[1] == PROTO_ERR_CRC);
+
+  test_nak(0x3F, req, 0, PROTO_ERR_OPCODE, __LINE__);
+
+  // The parser is back in step.
+  CHECK(test_call(PROTO_PING, req, 0, &reply) == JIG_OK);
+}
+
+// Rate changes: an unknown rate, a confirm with nothing to confirm, and
+// a change there and back.
+static void test_baud(void)
+{
+  struct jig_frame reply;
+  unsigned char req[4];
+
+  jig_put32(req, 12345);
+  test_nak(PROTO_SET_BAUD, req, 4, PROTO_ERR_ARG, __LINE__);
+  test_nak(PROTO_BAUD_CONFIRM, req, 0, PROTO_ERR_STATE, __LINE__);
+
+  CHECK(jig_change_baud(test_fd, 4800, TEST_WAIT_MS) == JIG_OK);
+  CHECK(test_call(PROTO_PING, req, 0, &reply) == JIG_OK);
+  CHECK(jig_change_baud(test_fd, 9600, TEST_WAIT_MS) == JIG_OK);
+  CHECK(test_call(PROTO_PING, req, 0, &reply) == JIG_OK);
+  CHECK(jig_bad_frames == 0);
+}
+
+int main(int argc, char **argv)
+{
+  pid_t pid;
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: jigtest path-to-ShutterJig-host\n");
+    return 2;
+  }
+  pid = test_start(argv[1]);
+
+  test_requests();
+  test_telemetry();
+  test_bad_frames();
+  test_baud();
+
+  close(test_fd);
+  kill(pid, SIGTERM);
+  waitpid(pid, 0, 0);
+
+  printf("jigtest: %d checks, %d failed\n", test_checks, test_failed);
+  return test_failed != 0;
+}
@@ -0,0 +1,50 @@
+/*  Filename:       locks.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Host simulation replacement for include/locks.h.  The
+    interrupt mask is a flag of the simulated CPU (see sim/sim.c); the
+    masks returned by lock have the I bit in the high part, as on the
+    HC11, so callers can test them the same way.
+*/
+
+#ifndef LOCKS_H
+#define LOCKS_H
+
+extern unsigned short sim_lock (void);
+extern void sim_restore (unsigned short mask);
+extern void sim_wait (void);
+
+static __inline__ unsigned short
+lock (void)
+{
+  return sim_lock ();
+}
+
+static __inline__ void
+unlock (void)
+{
+  sim_restore (0);
+}
+
+static __inline__ void
+unlock_and_wait (void)
+{
+  sim_wait ();
+}
+
+static __inline__ void
+restore (unsigned short mask)
+{
+  sim_restore (mask);
+}
+
+static __inline__ void
+interruption_point (void)
+{
+  sim_restore (0);
+  sim_lock ();
+}
+
+#endif
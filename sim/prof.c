@@ -0,0 +1,319 @@
+/*  Filename:       prof.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Per-function profile of the simulated firmware.  The
+    simulator calls sim_prof_step for every firmware instruction with the
+    E clocks it cost.  The instruction is charged to the function that
+    contains it (self) and to every function on its call chain (total).
+    Since every instruction is seen, the call chain is simply followed:
+    reaching the first instruction of a function is a call, and a frame
+    ends once the stack pointer is back above its entry value.  The
+    chain of an interrupt handler starts afresh, so interrupts are not
+    charged to the code they interrupted.  The function table is read
+    from the symbol table of the running executable.
+
+    The few simulator instructions that run traced are charged to their
+    sim_ functions: sim_lock, sim_restore and sim_wait stand for lock,
+    restore and WAI, sim_dispatch for the interrupt entry.
+*/
+
+#define _GNU_SOURCE
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define PROF_MAX_DEPTH  64
+
+struct prof_func
+{
+  unsigned long addr;
+  unsigned long size;
+  const char *name;
+  unsigned long calls;
+  unsigned long long self;
+  unsigned long long total;
+  unsigned long mark;
+};
+
+static struct prof_func *prof_funcs;
+static int prof_nfuncs;
+
+// Functions being run, as seen from the calls and returns: the function
+// and its stack pointer at entry.  The frames of an interrupt handler
+// start at prof_base.
+static struct
+{
+  struct prof_func *fn;
+  unsigned long sp;
+} prof_stack[PROF_MAX_DEPTH];
+static int prof_depth;
+static int prof_base;
+static unsigned long prof_stamp;
+static unsigned long long prof_other;
+
+static int prof_by_addr(const void *a, const void *b)
+{
+  const struct prof_func *x = a, *y = b;
+
+  return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static int prof_by_self(const void *a, const void *b)
+{
+  const struct prof_func *x = *(struct prof_func * const *) a;
+  const struct prof_func *y = *(struct prof_func * const *) b;
+
+  if(x->self != y->self)
+    return x->self > y->self ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+static int prof_by_name(const void *a, const void *b)
+{
+  const struct prof_func *x = *(struct prof_func * const *) a;
+  const struct prof_func *y = *(struct prof_func * const *) b;
+
+  return strcmp(x->name, y->name);
+}
+
+// Function containing an address, or 0.
+static struct prof_func *prof_find(unsigned long addr)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = prof_nfuncs - 1;
+  while(lo <= hi)
+  {
+    mid = (lo + hi) / 2;
+    if(addr < prof_funcs[mid].addr)
+      hi = mid - 1;
+    else if(addr >= prof_funcs[mid].addr + prof_funcs[mid].size)
+      lo = mid + 1;
+    else
+      return &prof_funcs[mid];
+  }
+  return 0;
+}
+
+// Read the function symbols of the executable.  The executable is
+// position independent, so the load address is found from the address
+// of this very function.
+void sim_prof_init(void)
+{
+  FILE *f;
+  long len;
+  char *image;
+  const Elf64_Ehdr *eh;
+  const Elf64_Shdr *sh;
+  const Elf64_Sym *sym;
+  const char *strtab;
+  unsigned long base, count, i;
+  int s;
+
+  f = fopen("/proc/self/exe", "rb");
+  if(f == 0)
+  {
+    perror("/proc/self/exe");
+    exit(2);
+  }
+  fseek(f, 0, SEEK_END);
+  len = ftell(f);
+  rewind(f);
+  image = malloc(len);
+  if(fread(image, 1, len, f) != (size_t) len)
+  {
+    fprintf(stderr, "sim: cannot read /proc/self/exe\n");
+    exit(2);
+  }
+  fclose(f);
+
+  eh = (const Elf64_Ehdr *) image;
+  sh = (const Elf64_Shdr *) (image + eh->e_shoff);
+  for(s = 0; s < eh->e_shnum; s++)
+  {
+    if(sh[s].sh_type != SHT_SYMTAB)
+      continue;
+
+    sym = (const Elf64_Sym *) (image + sh[s].sh_offset);
+    count = sh[s].sh_size / sizeof (Elf64_Sym);
+    strtab = image + sh[sh[s].sh_link].sh_offset;
+    prof_funcs = calloc(count, sizeof (struct prof_func));
+    for(i = 0; i < count; i++)
+    {
+      if(ELF64_ST_TYPE(sym[i].st_info) != STT_FUNC
+         || sym[i].st_shndx == SHN_UNDEF || sym[i].st_size == 0)
+        continue;
+      prof_funcs[prof_nfuncs].addr = sym[i].st_value;
+      prof_funcs[prof_nfuncs].size = sym[i].st_size;
+      prof_funcs[prof_nfuncs].name = strtab + sym[i].st_name;
+      prof_nfuncs++;
+    }
+  }
+  if(prof_nfuncs == 0)
+  {
+    fprintf(stderr, "sim: no symbols to profile with\n");
+    exit(2);
+  }
+
+  base = 0;
+  for(i = 0; i < (unsigned long) prof_nfuncs; i++)
+    if(strcmp(prof_funcs[i].name, "sim_prof_init") == 0)
+      base = (unsigned long) sim_prof_init - prof_funcs[i].addr;
+  for(i = 0; i < (unsigned long) prof_nfuncs; i++)
+    prof_funcs[i].addr += base;
+
+  qsort(prof_funcs, prof_nfuncs, sizeof (struct prof_func), prof_by_addr);
+}
+
+static void prof_add_total(struct prof_func *fn, unsigned long cycles)
+{
+  if(fn->mark == prof_stamp)
+    return;
+  fn->mark = prof_stamp;
+  fn->total += cycles;
+}
+
+void sim_prof_step(const ucontext_t *uc, unsigned long cycles)
+{
+  struct prof_func *fn;
+  unsigned long pc, sp;
+  int i;
+
+  pc = uc->uc_mcontext.gregs[REG_RIP];
+  sp = uc->uc_mcontext.gregs[REG_RSP];
+
+  // Functions that returned have their frame below the stack pointer.
+  while(prof_depth > prof_base && prof_stack[prof_depth - 1].sp < sp)
+    prof_depth--;
+
+  fn = prof_find(pc);
+  if(fn == 0)
+  {
+    prof_other += cycles;
+    return;
+  }
+
+  if(pc == fn->addr)
+  {
+    // Entry.  A frame at the same level was left by a jump.
+    fn->calls++;
+    if(prof_depth > prof_base && prof_stack[prof_depth - 1].sp == sp)
+      prof_depth--;
+    if(prof_depth < PROF_MAX_DEPTH)
+    {
+      prof_stack[prof_depth].fn = fn;
+      prof_stack[prof_depth].sp = sp;
+      prof_depth++;
+    }
+  }
+
+  prof_stamp++;
+  fn->self += cycles;
+  prof_add_total(fn, cycles);
+  for(i = prof_depth - 1; i >= prof_base; i--)
+    prof_add_total(prof_stack[i].fn, cycles);
+}
+
+// An interrupt handler is about to run.  Its call chain starts afresh,
+// so the code it interrupted is not charged for it.
+int sim_prof_enter(void)
+{
+  int base;
+
+  base = prof_base;
+  prof_base = prof_depth;
+  return base;
+}
+
+void sim_prof_leave(int base)
+{
+  prof_depth = prof_base;
+  prof_base = base;
+}
+
+// Charge cycles spent on behalf of a function outside of its code
+// (interrupt entry and return).
+void sim_prof_charge(void (*handler) (void), unsigned long cycles)
+{
+  struct prof_func *fn;
+
+  fn = prof_find((unsigned long) handler);
+  if(fn == 0)
+    return;
+  fn->self += cycles;
+  fn->total += cycles;
+}
+
+// Functions that ran, in the given order.
+static struct prof_func **prof_list(int (*order) (const void *, const void *),
+                                    int *count)
+{
+  struct prof_func **list;
+  int i, n;
+
+  list = malloc(prof_nfuncs * sizeof (*list));
+  for(i = n = 0; i < prof_nfuncs; i++)
+    if(prof_funcs[i].total)
+      list[n++] = &prof_funcs[i];
+  qsort(list, n, sizeof (*list), order);
+  *count = n;
+  return list;
+}
+
+// Table by decreasing self time.  The columns are blank separated, so
+// the table can be re-sorted with sort -k.
+void sim_prof_report(FILE *out, unsigned long long cycles)
+{
+  struct prof_func **list;
+  int i, n;
+
+  if(cycles == 0)
+    cycles = 1;
+
+  list = prof_list(prof_by_self, &n);
+  fprintf(out, "\n%12s %6s %12s %6s %8s  %s\n",
+          "self", "self%", "total", "total%", "calls", "function");
+  for(i = 0; i < n; i++)
+    fprintf(out, "%12llu %6.2f %12llu %6.2f %8lu  %s\n",
+            list[i]->self, 100.0 * list[i]->self / cycles,
+            list[i]->total, 100.0 * list[i]->total / cycles,
+            list[i]->calls, list[i]->name);
+  if(prof_other)
+    fprintf(out, "%12llu %6.2f %12s %6s %8s  %s\n", prof_other,
+            100.0 * prof_other / cycles, "-", "-", "-", "(outside)");
+  free(list);
+}
+
+// The same figures as JSON, by function name so that two runs can be
+// compared with diff.
+int sim_prof_json(const char *name, unsigned long long cycles)
+{
+  struct prof_func **list;
+  FILE *f;
+  int i, n;
+
+  f = fopen(name, "w");
+  if(f == 0)
+  {
+    perror(name);
+    return -1;
+  }
+
+  list = prof_list(prof_by_name, &n);
+  fprintf(f, "{\n  \"unit\": \"E clocks\",\n  \"cycles\": %llu,\n"
+          "  \"functions\": {\n", cycles);
+  for(i = 0; i < n; i++)
+    fprintf(f, "    \"%s\": { \"self\": %llu, \"total\": %llu, \"calls\": %lu }%s\n",
+            list[i]->name, list[i]->self, list[i]->total, list[i]->calls,
+            i + 1 < n ? "," : "");
+  fprintf(f, "  }\n}\n");
+  free(list);
+  return fclose(f);
+}
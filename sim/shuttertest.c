@@ -0,0 +1,331 @@
+/*  Filename:       shuttertest.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Test of the shutter state machine (make shuttertest).
+    shutter.c is linked against a stand-in pulse engine, supervisor and
+    statistics, so every (state, input) pair of its table can be given
+    on channel 0 and checked against the next state and the action
+    expected: a pulse and its direction, a queued command or a skipped
+    one.  It then runs the command queue up to full, a close given
+    while the shutter is opening, and the faults: a pulse refused by the
+    engine or by the supervisor, and a trip during the pulse.
+
+    The build has no SENSE_ENABLE, so a pulse that runs its course
+    always ends at rest in its direction.
+
+    Each failed check is printed; the exit status is 1 if any failed.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ShutterJig.h"
+#include "shutter.h"
+#include "stats.h"
+#include "adc.h"
+#include "guard.h"
+
+#define TEST_ON     1                   // stand-in engine: pulse on
+#define TEST_DEAD   2                   // stand-in engine: dead time
+
+static int test_checks;
+static int test_failed;
+
+#define CHECK(COND) test_check((COND), #COND, __LINE__)
+
+static void test_check(int ok, const char *what, int line)
+{
+  test_checks++;
+  if(ok)
+    return;
+  test_failed++;
+  printf("shuttertest.c:%d: failed: %s\n", line, what);
+}
+
+// Stand-in pulse engine: the phase of each channel, the pulses taken
+// and whether the next one is refused.
+static unsigned char test_phase[SHUTTER_CHANNELS];
+static int test_pulses;
+static unsigned char test_direction;
+static unsigned char test_refuse;
+static int test_cancels;
+
+guard_t guard;
+
+unsigned char shutter_pulse(unsigned char ch, unsigned char direction,
+                            unsigned long on_us, unsigned long dead_us)
+{
+  if(test_phase[ch] || test_refuse || guard.fault != GUARD_OK)
+    return 0;
+  test_phase[ch] = TEST_ON;
+  test_pulses++;
+  test_direction = direction;
+  return 1;
+}
+
+unsigned char pulse_busy(unsigned char ch)
+{
+  return test_phase[ch] != 0;
+}
+
+unsigned char pulse_driving(unsigned char ch)
+{
+  return test_phase[ch] == TEST_ON;
+}
+
+unsigned short pulse_leading_edge(unsigned char ch)
+{
+  return 0;
+}
+
+void adc_start(unsigned char ch, unsigned char direction)
+{
+}
+
+void stats_coil_on(unsigned short on)
+{
+}
+
+void stats_press_cancel(void)
+{
+  test_cancels++;
+}
+
+// Start over with channel 0 in a given state and the engine idle.
+static void test_reset(unsigned char state)
+{
+  shutter_init();
+  memset(test_phase, 0, sizeof (test_phase));
+  test_pulses = 0;
+  test_direction = 0;
+  test_refuse = 0;
+  test_cancels = 0;
+  guard.fault = GUARD_OK;
+  shutters[0].state = state;
+}
+
+// Number of commands queued on channel 0.
+static int test_queued(void)
+{
+  return (shutters[0].queue_head - shutters[0].queue_tail)
+    & (SHUTTER_QUEUE_SIZE - 1);
+}
+
+// End the pulse, then the dead time, of channel 0.
+static void test_coil_off(void)
+{
+  test_phase[0] = TEST_DEAD;
+  shutter_update();
+}
+
+static void test_done(void)
+{
+  test_phase[0] = 0;
+  shutter_update();
+}
+
+// Expected outcome of each (state, input) pair: the next state and what
+// is done on the way.
+#define X_NONE      0
+#define X_OPEN      1                   // an open pulse is started
+#define X_CLOSE     2                   // a close pulse is started
+#define X_QUEUE     3                   // the command is queued
+#define X_SKIP      4                   // the command is dropped, done
+
+struct test_pair
+{
+  unsigned char next;
+  unsigned char effect;
+};
+
+static const struct test_pair test_table[SHUTTER_STATES][SHUTTER_INPUTS] =
+{
+  /* IDLE */
+  { { SHUTTER_DRIVE_OPEN, X_OPEN }, { SHUTTER_DRIVE_CLOSE, X_CLOSE },
+    { SHUTTER_IDLE, X_NONE }, { SHUTTER_IDLE, X_NONE } },
+  /* DRIVE_OPEN */
+  { { SHUTTER_DRIVE_OPEN, X_QUEUE }, { SHUTTER_DRIVE_OPEN, X_QUEUE },
+    { SHUTTER_DEAD_OPEN, X_NONE }, { SHUTTER_OPENED, X_NONE } },
+  /* DEAD_OPEN */
+  { { SHUTTER_DEAD_OPEN, X_QUEUE }, { SHUTTER_DEAD_OPEN, X_QUEUE },
+    { SHUTTER_DEAD_OPEN, X_NONE }, { SHUTTER_OPENED, X_NONE } },
+  /* OPENED */
+  { { SHUTTER_OPENED, X_SKIP }, { SHUTTER_DRIVE_CLOSE, X_CLOSE },
+    { SHUTTER_OPENED, X_NONE }, { SHUTTER_OPENED, X_NONE } },
+  /* DRIVE_CLOSE */
+  { { SHUTTER_DRIVE_CLOSE, X_QUEUE }, { SHUTTER_DRIVE_CLOSE, X_QUEUE },
+    { SHUTTER_DEAD_CLOSE, X_NONE }, { SHUTTER_CLOSED, X_NONE } },
+  /* DEAD_CLOSE */
+  { { SHUTTER_DEAD_CLOSE, X_QUEUE }, { SHUTTER_DEAD_CLOSE, X_QUEUE },
+    { SHUTTER_DEAD_CLOSE, X_NONE }, { SHUTTER_CLOSED, X_NONE } },
+  /* CLOSED */
+  { { SHUTTER_DRIVE_OPEN, X_OPEN }, { SHUTTER_CLOSED, X_SKIP },
+    { SHUTTER_CLOSED, X_NONE }, { SHUTTER_CLOSED, X_NONE } }
+};
+
+// Give every input in every state.  The engine inputs come through
+// shutter_update with the stand-in engine in the matching phase; the
+// commands through shutter_command with the engine in the phase of the
+// state, so a command is only started from rest.
+static void test_pairs(void)
+{
+  const struct test_pair *want;
+  unsigned char state, input;
+
+  for(state = 0; state < SHUTTER_STATES; state++)
+    for(input = 0; input < SHUTTER_INPUTS; input++)
+    {
+      want = &test_table[state][input];
+      test_reset(state);
+
+      switch(input)
+      {
+        case SHUTTER_COIL_OFF:
+          test_coil_off();
+          break;
+
+        case SHUTTER_PULSE_DONE:
+          test_done();
+          break;
+
+        default:
+          if(state == SHUTTER_DRIVE_OPEN || state == SHUTTER_DRIVE_CLOSE)
+            test_phase[0] = TEST_ON;
+          else if(state == SHUTTER_DEAD_OPEN || state == SHUTTER_DEAD_CLOSE)
+            test_phase[0] = TEST_DEAD;
+          shutter_command(0, input);
+          break;
+      }
+
+      if(shutters[0].state != want->next || shutters[0].fault != 0
+         || test_pulses != (want->effect == X_OPEN || want->effect == X_CLOSE)
+         || (want->effect == X_OPEN && test_direction != PULSE_OPEN)
+         || (want->effect == X_CLOSE && test_direction != PULSE_CLOSE)
+         || test_queued() != (want->effect == X_QUEUE)
+         || (want->effect == X_QUEUE
+             && shutters[0].queue[shutters[0].queue_tail] != input)
+         || test_cancels != (want->effect == X_SKIP))
+      {
+        test_check(0, "state/input pair", __LINE__);
+        printf("  state %s, input %d: now %s, %d pulses, %d queued\n",
+               shutter_state_name(state), input,
+               shutter_state_name(shutters[0].state), test_pulses,
+               test_queued());
+      }
+      else
+        test_check(1, "", __LINE__);
+    }
+}
+
+// Fill the queue while a pulse is on: it holds one command less than
+// its size, the next is counted as dropped, and the others are carried
+// out in order as the shutter comes to rest.
+static void test_queue(void)
+{
+  static const unsigned char cmds[] =
+  {
+    SHUTTER_CMD_CLOSE, SHUTTER_CMD_OPEN, SHUTTER_CMD_CLOSE, SHUTTER_CMD_OPEN
+  };
+  int i;
+
+  test_reset(SHUTTER_CLOSED);
+  shutter_command(0, SHUTTER_CMD_OPEN);
+  CHECK(shutters[0].state == SHUTTER_DRIVE_OPEN && test_pulses == 1);
+
+  for(i = 0; i < SHUTTER_QUEUE_SIZE; i++)
+    shutter_command(0, cmds[i]);
+  CHECK(test_queued() == SHUTTER_QUEUE_SIZE - 1);
+  CHECK(shutters[0].queue_drops == 1);
+  CHECK(!shutter_ready(0));
+
+  // Each rest starts the oldest command left.
+  for(i = 0; i < SHUTTER_QUEUE_SIZE - 1; i++)
+  {
+    test_coil_off();
+    test_done();
+    CHECK(test_pulses == i + 2);
+    CHECK(test_direction == (cmds[i] == SHUTTER_CMD_OPEN ? PULSE_OPEN
+                                                         : PULSE_CLOSE));
+    CHECK(shutters[0].state == (cmds[i] == SHUTTER_CMD_OPEN
+                                ? SHUTTER_DRIVE_OPEN : SHUTTER_DRIVE_CLOSE));
+  }
+  CHECK(test_queued() == 0);
+
+  test_coil_off();
+  test_done();
+  CHECK(shutters[0].state == SHUTTER_CLOSED && test_pulses == 4);
+  CHECK(shutter_ready(0));
+}
+
+// A close given while the shutter is opening waits for the open pulse
+// and its dead time, then reverses.
+static void test_reversal(void)
+{
+  test_reset(SHUTTER_CLOSED);
+  shutter_command(0, SHUTTER_CMD_OPEN);
+  shutter_command(0, SHUTTER_CMD_CLOSE);
+  CHECK(shutters[0].state == SHUTTER_DRIVE_OPEN && test_queued() == 1);
+
+  test_coil_off();
+  CHECK(shutters[0].state == SHUTTER_DEAD_OPEN && test_pulses == 1);
+
+  test_done();
+  CHECK(shutters[0].state == SHUTTER_DRIVE_CLOSE && test_pulses == 2);
+  CHECK(test_direction == PULSE_CLOSE && test_queued() == 0);
+
+  test_coil_off();
+  test_done();
+  CHECK(shutters[0].state == SHUTTER_CLOSED && shutters[0].fault == 0);
+}
+
+// A refused pulse leaves the state alone and latches a fault: START
+// from the engine, GUARD from the supervisor.  A trip during the pulse
+// leaves the position unknown.
+static void test_faults(void)
+{
+  test_reset(SHUTTER_CLOSED);
+  test_refuse = 1;
+  shutter_command(0, SHUTTER_CMD_OPEN);
+  CHECK(shutters[0].state == SHUTTER_CLOSED);
+  CHECK(shutters[0].fault == SHUTTER_FAULT_START);
+
+  test_reset(SHUTTER_OPENED);
+  guard.fault = 1;
+  shutter_command(0, SHUTTER_CMD_CLOSE);
+  CHECK(shutters[0].state == SHUTTER_OPENED);
+  CHECK(shutters[0].fault == SHUTTER_FAULT_GUARD);
+
+  test_reset(SHUTTER_CLOSED);
+  shutter_command(0, SHUTTER_CMD_OPEN);
+  guard.fault = 1;
+  test_coil_off();
+  test_done();
+  CHECK(shutters[0].state == SHUTTER_IDLE);
+  CHECK(shutters[0].fault == SHUTTER_FAULT_GUARD);
+
+  // A queued command is still given after the trip, and refused.
+  test_reset(SHUTTER_CLOSED);
+  shutter_command(0, SHUTTER_CMD_OPEN);
+  shutter_command(0, SHUTTER_CMD_CLOSE);
+  guard.fault = 1;
+  test_coil_off();
+  test_done();
+  CHECK(shutters[0].state == SHUTTER_IDLE && test_pulses == 1);
+  CHECK(shutters[0].fault == SHUTTER_FAULT_GUARD && test_queued() == 0);
+
+  // The other channels are left alone.
+  CHECK(shutters[1].state == SHUTTER_IDLE && shutters[1].fault == 0);
+}
+
+int main(void)
+{
+  test_pairs();
+  test_queue();
+  test_reversal();
+  test_faults();
+
+  printf("shuttertest: %d checks, %d failed\n", test_checks, test_failed);
+  return test_failed != 0;
+}
@@ -0,0 +1,1662 @@
+/*  Filename:       sim.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Host simulation of the Shutter Jig board, linked with
+    the unchanged firmware sources by "make host".
+
+    The I/O registers (_io_ports) and the LCD registers each live alone
+    in a page with no access rights.  A firmware access faults; the
+    fault handler loads the current register values into the page,
+    opens it and single steps the instruction, then applies the side
+    effects of the access (flags cleared by writing ones, SCDR, the LCD
+    controller, ...) and closes the page again.
+
+    The firmware itself runs single stepped with the x86 trap flag.
+    Each instruction costs SIM_INSN_CYCLES E clocks by default, and the
+    timer, SCI, LCD and stimulus models advance by that much; pending
+    interrupts are taken between two instructions whenever the simulated
+    I bit is clear.  WAI skips ahead to the next interrupt, so idle time
+    costs nothing on the host.  The results are therefore in simulated
+    E clocks, repeatable from run to run, and only as accurate as the
+    cost per instruction (override it with -c).
+
+    The EEPROM page follows the PPROG sequences: a write only latches
+    the address and data while EELAT is set, and the byte is erased or
+    programmed when EEPGM goes off again at least EE_PROG_US after it
+    went on.  Anything else (a read or a write at the wrong time, a step
+    cut short) is counted as an error and leaves the EEPROM unchanged.
+    So is a step on a block that BPROT protects; BPROT comes out of
+    reset as 0x1F and can only be written in the first 64 E clocks.
+    With -e the EEPROM is loaded from a file, if it exists, and saved
+    back at the end, so a run can follow on from the previous one.
+
+    With -s the serial line goes to a pseudo terminal instead, whose
+    name is printed at the start, so a host program (sim/jigctl for
+    instance) can talk to the firmware; the simulation then keeps pace
+    with the wall clock when it can, and runs until -t, the end of the
+    script or an interrupt signal.
+
+    With -m the channel 0 shutter moves: it takes the given time to
+    open (and to close, if a second time follows a comma) while that half
+    of the bridge is on, and stays where it is otherwise.  Its end-of-
+    travel sensors drive PA0 and PA1 and the input captures on them (see
+    sense.h), so -m needs a "make SENSE=1" build.  "travel <open_ms>
+    [,<close_ms>]" in the script changes the times, for a mechanism that
+    slows down or speeds up.
+
+    The coils of bridges 0 to 2 are resistors in series with an
+    inductance, fed from a supply with some source resistance, and their
+    current and the supply voltage drive the A/D inputs PE0 to PE3 with
+    the scaling of adc.h.  The report has the energy each pulse really
+    took, to check the figures of the I command against.
+
+    "glitch <ch> open|close|both" in the script turns bridge pins on
+    behind the firmware's back, as a stray port write would, for the
+    supervisor (guard.h) to catch.  Output compare 1 drives the Port A
+    pins set in OC1M, so its forced compare takes them off again.
+
+    "width <us>" in the script gives the on time of the channel 0 pulses
+    that follow.  Each PA4 or PA5 high time is measured against it, and
+    the run fails (exit status 1) if one is off by more than a TCNT tick
+    or if no pulse came before the next "width" or the end.
+
+    Usage: ShutterJig-host [-q] [-s] [-c cycles] [-t ms] [-p json] [-e file]
+                           [-m open_ms[,close_ms]] [script]
+
+    The script drives the buttons and the serial line, one event per
+    line, with times in milliseconds since reset.  The run stops at the
+    "end" event, after -t ms, or after SIM_END_MS:
+
+      500   type    12:00:00\r
+      1000  press   open
+      1150  release open
+      10000 end
+
+    A button is open, close, clear or its number (see buttons.h).
+    "baud <rate>" sets the rate of the terminal on the serial line; by
+    default it follows the firmware.  While the two differ by more than
+    2.5%, the firmware receives framing errors and the console shows
+    '?' for each character sent.
+
+    The console output goes to stdout (unless -q); a report follows
+    when the simulation ends.  With -p the report also has the E clocks
+    spent in each function (see prof.c), which are written to the JSON
+    file as well.
+*/
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <termios.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "buttons.h"
+#include "eeprom.h"
+#include "sim.h"
+
+#define SIM_PAGE          4096
+#define SIM_TF            0x100         /* x86 trap flag */
+#define SIM_PF_WRITE      0x2           /* page fault caused by a write */
+
+#define SIM_INSN_CYCLES   3             /* E clocks per host instruction */
+#define SIM_IRQ_CYCLES    26            /* stacking, vector fetch and RTI */
+#define SIM_WAI_CYCLES    14            /* stacking done by WAI */
+#define SIM_END_MS        10000L
+
+#define SIM_RTI_CYCLES    8192          /* RTI period with RTR = 0 */
+#define SIM_LCD_US        37            /* most HD44780 operations */
+#define SIM_LCD_HOME_US   1520          /* clear and home */
+#define SIM_BPROT_RESET   0x1F          /* every EEPROM block protected */
+#define SIM_BPROT_CYCLES  64            /* BPROT writable until then */
+
+#define SIM_MAX_EVENTS    256
+#define SIM_RX_SIZE       1024
+
+#define SIM_COIL_OHMS     6             /* coil resistance */
+#define SIM_COIL_TAU_US   5000          /* its L/R time constant */
+#define SIM_SUPPLY_MV     12000L
+#define SIM_SOURCE_MOHMS  200           /* source resistance of the supply */
+
+#define SIM_US(C)         ((C) * 1000000.0 / M6811_CPU_E_CLOCK)
+
+/* The register pages.  The LCD and EEPROM symbols normally come from
+   memory.x.  */
+volatile unsigned char _io_ports[SIM_PAGE] __attribute__((aligned(SIM_PAGE)));
+volatile unsigned char sim_lcd_page[SIM_PAGE] __attribute__((aligned(SIM_PAGE)));
+volatile unsigned char sim_ee_page[SIM_PAGE] __attribute__((aligned(SIM_PAGE)));
+
+__asm__ (".globl _gdm_lcd_cmd\n\t"
+         ".set _gdm_lcd_cmd, sim_lcd_page\n\t"
+         ".globl _gdm_lcd_data\n\t"
+         ".set _gdm_lcd_data, sim_lcd_page + 1\n\t"
+         ".globl _eeprom\n\t"
+         ".set _eeprom, sim_ee_page");
+
+/* Script events.  */
+#define SIM_EV_PRESS      1
+#define SIM_EV_RELEASE    2
+#define SIM_EV_TYPE       3
+#define SIM_EV_END        4
+#define SIM_EV_BAUD       5
+#define SIM_EV_TRAVEL     6
+#define SIM_EV_GLITCH     7
+#define SIM_EV_WIDTH      8
+
+struct sim_event
+{
+  unsigned long long at;                /* E clock of the event */
+  unsigned char type;
+  unsigned char button;
+  char *text;
+  unsigned long baud;
+  unsigned long long travel[2];
+  unsigned char pins;                   /* glitch: pins of channel button */
+  unsigned long width;                  /* width: on time, in us */
+};
+
+struct sim_stat
+{
+  unsigned long n;
+  unsigned long long min;
+  unsigned long long max;
+  unsigned long long sum;
+};
+
+static const char *sim_script;
+static const char *sim_profile;
+static const char *sim_ee_file;
+static int sim_use_pty;
+static int sim_pty = -1;
+static struct timespec sim_pty_start;
+static volatile sig_atomic_t sim_stop;
+static int sim_quiet;
+static unsigned long sim_insn_cycles = SIM_INSN_CYCLES;
+static unsigned long long sim_end;
+
+static struct sim_event sim_events[SIM_MAX_EVENTS];
+static int sim_nevents;
+static int sim_next_event;
+
+/* CPU.  */
+static unsigned long long sim_cycles;
+static unsigned long long sim_idle;
+static unsigned long long sim_insns;
+static unsigned char sim_imask;
+static interrupt_t sim_vectors[MAX_VECTORS];
+static unsigned long sim_irq_count[MAX_VECTORS];
+static unsigned long long sim_irq_cycles[MAX_VECTORS];
+
+/* Register file.  The 16-bit registers are kept in host order, since
+   the firmware reads them with 16-bit loads.  */
+static unsigned char sim_regs[M6811_IO_SIZE];
+
+/* Access being single stepped.  */
+static volatile unsigned char *sim_access;
+static volatile unsigned char *sim_access_page;
+static int sim_access_write;
+static int sim_access_traced;
+
+/* Timer.  */
+static unsigned short sim_tcnt;
+static unsigned int sim_presc;
+static unsigned long sim_rti_left;
+static unsigned long long sim_rti_at;   // when RTIF was last set
+
+/* Buttons (bit n for button n, on Port A and E) and the Port A
+   output latch.  */
+static unsigned char sim_buttons;
+static unsigned char sim_pa_out;
+
+/* Channel 0 shutter (-m): E clocks to open and to close, and the
+   position, from 0 (closed) to sim_travel[0] * sim_travel[1] (open),
+   so each E clock moves it by a whole step.  */
+static unsigned long long sim_travel[2];
+static unsigned long long sim_pos;
+static unsigned char sim_sense;
+static unsigned long long sim_drive_at;
+
+/* SCI.  */
+static unsigned char sim_tdr;
+static int sim_tdr_full;
+static unsigned char sim_tx_shift;
+static unsigned long sim_tx_left;
+static unsigned char sim_rdr;
+static unsigned long sim_rx_left;
+static char sim_rx_text[SIM_RX_SIZE];
+static unsigned int sim_rx_head;
+static unsigned int sim_rx_tail;
+static unsigned long sim_term_baud;     // 0: same as the firmware
+static unsigned long sim_garbled;
+
+/* LCD controller.  */
+static unsigned char sim_ddram[128];
+static unsigned char sim_ac;
+static unsigned long long sim_lcd_ready;
+
+/* EEPROM: its contents and the byte latched for the next step.  */
+static unsigned char sim_eeprom[EE_SIZE];
+static unsigned short sim_ee_addr;
+static unsigned char sim_ee_data;
+static int sim_ee_latched;
+static unsigned long long sim_ee_pgm_at;
+
+/* Measurements.  */
+static unsigned long sim_lcd_bytes;
+static unsigned long sim_lcd_violations;
+static unsigned long sim_tx_bytes;
+static unsigned long sim_tx_lost;
+static unsigned long sim_rx_bytes;
+static unsigned long sim_rx_lost;
+static unsigned long sim_shoot_through;
+static unsigned long sim_ee_programs;
+static unsigned long sim_ee_erases;
+static unsigned long sim_ee_errors;
+static unsigned long long sim_press_at;
+static unsigned long long sim_button_rti;
+static struct sim_stat sim_rti_to_coil;
+static struct sim_stat sim_press_to_coil;
+static struct sim_stat sim_travel_stat[2];
+static unsigned long sim_travel_short;
+
+/* Coils of bridges 0 to 2: the current, in mA, and the energy of the
+   pulse under way, in uJ, then the pulses that ended.  */
+static double sim_coil_ma[ADC_CHANNELS];
+static double sim_coil_uj[ADC_CHANNELS];
+static unsigned char sim_coil_on[ADC_CHANNELS];
+static unsigned long sim_coil_pulses;
+static double sim_coil_mj;
+static double sim_coil_peak;
+
+/* Last glitch: its channel and E clock, until its pins are off.  */
+static int sim_glitch_ch = -1;
+static unsigned long long sim_glitch_at;
+static struct sim_stat sim_glitch_stat;
+
+/* Channel 0 pulse widths: the on time expected (E clocks, 0 for none),
+   the E clock of the last rising edge, the error of each high time and
+   the checks failed.  */
+#define SIM_TICK_CYCLES   (TB_US_PER_TICK * (M6811_CPU_E_CLOCK / 1000000L))
+static unsigned long long sim_width;
+static int sim_width_seen;
+static unsigned long long sim_width_at;
+static struct sim_stat sim_width_stat;
+static unsigned long sim_width_bad;
+
+static void sim_finish (int status) __attribute__((noreturn));
+
+// Turn single stepping of the code that follows on or off.  The flags
+// are pushed below the red zone of the current function.
+static inline void sim_trace(int on)
+{
+  if(on)
+    __asm__ __volatile__ ("lea -128(%%rsp), %%rsp\n\t"
+                          "pushfq\n\t"
+                          "orq $0x100, (%%rsp)\n\t"
+                          "popfq\n\t"
+                          "lea 128(%%rsp), %%rsp" : : : "cc", "memory");
+  else
+    __asm__ __volatile__ ("lea -128(%%rsp), %%rsp\n\t"
+                          "pushfq\n\t"
+                          "andq $-257, (%%rsp)\n\t"
+                          "popfq\n\t"
+                          "lea 128(%%rsp), %%rsp" : : : "cc", "memory");
+}
+
+static void sim_stat_add(struct sim_stat *s, unsigned long long v)
+{
+  if(s->n == 0 || v < s->min)
+    s->min = v;
+  if(v > s->max)
+    s->max = v;
+  s->sum += v;
+  s->n++;
+}
+
+// E clocks per character at the current BAUD setting (1 start, 8 data,
+// 1 stop bit).
+static unsigned long sim_char_cycles(void)
+{
+  static const unsigned char scp[4] = { 1, 3, 4, 13 };
+  unsigned char baud;
+
+  baud = sim_regs[M6811_BAUD];
+  return 10UL * 16 * scp[(baud >> 4) & 3] * (1 << (baud & 7));
+}
+
+// Port A pins as read by the firmware.
+static unsigned char sim_porta(void)
+{
+  return (sim_buttons & BUTTON_MASK_A) | sim_sense
+    | (sim_pa_out & ~(PA0 | PA1 | PA2));
+}
+
+// Latch TCNT in input capture n (1 to 3) if it takes this edge.
+static void sim_capture(int n, int rising)
+{
+  unsigned char edges;
+
+  edges = (sim_regs[M6811_TCTL2] >> (2 * (3 - n))) & 3;
+  if(edges != (rising ? 1 : 2) && edges != 3)
+    return;
+  memcpy(&sim_regs[M6811_TIC1 + 2 * (n - 1)], &sim_tcnt, sizeof (sim_tcnt));
+  sim_regs[M6811_TFLG1] |= M6811_IC1F >> (n - 1);
+}
+
+// Follow the input pins PA0 to PA2 (IC3 to IC1) after a change.
+static void sim_inputs(unsigned char before)
+{
+  unsigned char pins, bit;
+  int n;
+
+  pins = sim_porta();
+  for(n = 1; n <= 3; n++)
+  {
+    bit = PA2 >> (n - 1);
+    if((pins ^ before) & bit)
+      sim_capture(n, pins & bit);
+  }
+}
+
+// Move the channel 0 shutter by one E clock, and follow its sensors.
+static void sim_mech(void)
+{
+  unsigned long long full;
+  unsigned char drive, before, sense;
+
+  full = sim_travel[0] * sim_travel[1];
+  drive = sim_pa_out & (PA4 | PA5);
+  if(drive == PA5 && sim_pos < full)
+  {
+    sim_pos += sim_travel[1];
+    if(sim_pos >= full)
+    {
+      sim_pos = full;
+      sim_stat_add(&sim_travel_stat[0], sim_cycles - sim_drive_at);
+    }
+  }
+  else if(drive == PA4 && sim_pos > 0)
+  {
+    sim_pos = sim_pos > sim_travel[0] ? sim_pos - sim_travel[0] : 0;
+    if(sim_pos == 0)
+      sim_stat_add(&sim_travel_stat[1], sim_cycles - sim_drive_at);
+  }
+
+  sense = (sim_pos == full ? SENSE_OPEN_PIN : 0)
+    | (sim_pos == 0 ? SENSE_CLOSED_PIN : 0);
+  if(sense != sim_sense)
+  {
+    before = sim_porta();
+    sim_sense = sense;
+    sim_inputs(before);
+  }
+}
+
+// Current output of a bridge pin port.
+static unsigned char sim_port_out(unsigned char port)
+{
+  return port == M6811_PORTA ? sim_pa_out : sim_regs[port];
+}
+
+// Count the bridges that just got both halves on.
+static void sim_bridges(void)
+{
+  static unsigned char both[PULSE_CHANNELS];
+  unsigned char pins, ch, on;
+
+  for(ch = 0; ch < PULSE_CHANNELS; ch++)
+  {
+    pins = pulse_pins[ch].open | pulse_pins[ch].close;
+    on = (sim_port_out(pulse_pins[ch].port) & pins) == pins;
+    if(on && !both[ch])
+      sim_shoot_through++;
+    both[ch] = on;
+
+    if(ch == sim_glitch_ch && !(sim_port_out(pulse_pins[ch].port) & pins))
+    {
+      sim_stat_add(&sim_glitch_stat, sim_cycles - sim_glitch_at);
+      sim_glitch_ch = -1;
+    }
+  }
+}
+
+// Check a channel 0 high time against the "width" of the script.
+static void sim_pulse_width(unsigned char rising, unsigned char falling)
+{
+  unsigned long long high, err;
+
+  if(rising)
+    sim_width_at = sim_cycles;
+  if(!falling || !sim_width)
+    return;
+
+  high = sim_cycles - sim_width_at;
+  err = high > sim_width ? high - sim_width : sim_width - high;
+  sim_stat_add(&sim_width_stat, err);
+  if(err > SIM_TICK_CYCLES)
+  {
+    fprintf(stderr, "sim: pulse of %.0f us, %.0f us expected\n",
+            SIM_US((double) high), SIM_US((double) sim_width));
+    sim_width_bad++;
+  }
+  sim_width_seen = 1;
+}
+
+// Follow the bridge pins after a change of the Port A outputs.
+static void sim_pins(unsigned char before)
+{
+  unsigned char rising, falling;
+
+  rising = sim_pa_out & ~before & (PA4 | PA5);
+  falling = before & ~sim_pa_out & (PA4 | PA5);
+  sim_bridges();
+
+  // A drive that ends before the shutter gets to the end.
+  if(rising)
+    sim_drive_at = sim_cycles;
+  sim_pulse_width(rising, falling);
+  if(sim_travel[0] && (((falling & PA5) && sim_pos != sim_travel[0] * sim_travel[1])
+                       || ((falling & PA4) && sim_pos != 0)))
+    sim_travel_short++;
+
+  if(rising && sim_press_at)
+  {
+    sim_stat_add(&sim_press_to_coil, sim_cycles - sim_press_at);
+    if(sim_button_rti)
+      sim_stat_add(&sim_rti_to_coil, sim_cycles - sim_button_rti);
+    sim_press_at = 0;
+    sim_button_rti = 0;
+  }
+}
+
+// Apply the action of output compare 1 to the Port A pins set in OC1M.
+static void sim_oc1_action(void)
+{
+  unsigned char mask, before;
+
+  mask = sim_regs[M6811_OC1M] & (PA3 | PA4 | PA5 | PA6 | PA7);
+  if(mask == 0)
+    return;
+  before = sim_pa_out;
+  sim_pa_out = (sim_pa_out & ~mask) | (sim_regs[M6811_OC1D] & mask);
+  sim_pins(before);
+}
+
+// Apply the action of output compare n (2 to 5) to its Port A pin.
+static void sim_oc_action(int n)
+{
+  unsigned char bit, before;
+
+  bit = PA6 >> (n - 2);
+  before = sim_pa_out;
+  switch((sim_regs[M6811_TCTL1] >> (2 * (5 - n))) & 3)
+  {
+    case 1:
+      sim_pa_out ^= bit;
+      break;
+    case 2:
+      sim_pa_out &= ~bit;
+      break;
+    case 3:
+      sim_pa_out |= bit;
+      break;
+  }
+  sim_pins(before);
+}
+
+// One TCNT increment.
+static void sim_timer_tick(void)
+{
+  unsigned short toc;
+  int n;
+
+  sim_tcnt++;
+  if(sim_tcnt == 0)
+    sim_regs[M6811_TFLG2] |= M6811_TOF;
+
+  for(n = 1; n <= 5; n++)
+  {
+    memcpy(&toc, &sim_regs[M6811_TOC1 + 2 * (n - 1)], sizeof (toc));
+    if(toc != sim_tcnt)
+      continue;
+
+    sim_regs[M6811_TFLG1] |= M6811_OC1F >> (n - 1);
+    if(n >= 2)
+      sim_oc_action(n);
+    else
+      sim_oc1_action();
+  }
+}
+
+// Supply voltage, in mV, with the drop of the coil currents.
+static double sim_supply(void)
+{
+  double ma;
+  int ch;
+
+  ma = 0;
+  for(ch = 0; ch < ADC_CHANNELS; ch++)
+    ma += sim_coil_ma[ch];
+  return SIM_SUPPLY_MV - ma * SIM_SOURCE_MOHMS / 1000;
+}
+
+// Move the coil currents on by the given number of E clocks.  A coil
+// is on while either half of its bridge is; its current stops as soon
+// as both are off.
+static void sim_coils(unsigned long cycles)
+{
+  unsigned char pins;
+  double mv, dt;
+  int ch;
+
+  mv = sim_supply();
+  dt = SIM_US((double) cycles);
+  for(ch = 0; ch < ADC_CHANNELS; ch++)
+  {
+    pins = pulse_pins[ch].open | pulse_pins[ch].close;
+    if(sim_port_out(pulse_pins[ch].port) & pins)
+    {
+      sim_coil_ma[ch] += (mv / SIM_COIL_OHMS - sim_coil_ma[ch]) * dt / SIM_COIL_TAU_US;
+      sim_coil_uj[ch] += mv * sim_coil_ma[ch] * dt / 1e6;
+      if(sim_coil_ma[ch] > sim_coil_peak)
+        sim_coil_peak = sim_coil_ma[ch];
+      sim_coil_on[ch] = 1;
+    }
+    else if(sim_coil_on[ch])
+    {
+      sim_coil_pulses++;
+      sim_coil_mj += sim_coil_uj[ch] / 1000;
+      sim_coil_ma[ch] = 0;
+      sim_coil_uj[ch] = 0;
+      sim_coil_on[ch] = 0;
+    }
+  }
+}
+
+// A/D result of a value against its full scale.
+static unsigned char sim_adc(double val, double full)
+{
+  val = val * 256 / full;
+  return val >= 255 ? 255 : (unsigned char) val;
+}
+
+// Return != 0 if the terminal is not at the rate of the firmware.
+static int sim_baud_mismatch(void)
+{
+  unsigned long board;
+
+  if(sim_term_baud == 0)
+    return 0;
+  board = M6811_CPU_E_CLOCK / (sim_char_cycles() / 10);
+  return (board > sim_term_baud ? board - sim_term_baud
+                                : sim_term_baud - board) * 40 > sim_term_baud;
+}
+
+// A character has been shifted out.
+static void sim_tx_done(void)
+{
+  sim_tx_bytes++;
+  if(sim_baud_mismatch())
+  {
+    sim_tx_shift = '?';
+    sim_garbled++;
+  }
+  if(sim_pty >= 0)
+  {
+    // Dropped when the host program does not keep up.
+    if(write(sim_pty, &sim_tx_shift, 1) != 1)
+      sim_tx_lost++;
+  }
+  else if(!sim_quiet)
+    putchar(sim_tx_shift);
+}
+
+// Take what the host program wrote to the pseudo terminal, and wait
+// for the wall clock to catch up with the simulation.
+static void sim_pty_poll(void)
+{
+  struct timespec now, wait;
+  char buf[64];
+  long long ahead;
+  int n, i;
+
+  n = read(sim_pty, buf, sizeof (buf));
+  for(i = 0; i < n; i++)
+    if(sim_rx_head - sim_rx_tail < SIM_RX_SIZE)
+      sim_rx_text[sim_rx_head++ % SIM_RX_SIZE] = buf[i];
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  ahead = (long long) (sim_cycles * (1000000000.0 / M6811_CPU_E_CLOCK))
+    - (now.tv_sec - sim_pty_start.tv_sec) * 1000000000LL
+    - (now.tv_nsec - sim_pty_start.tv_nsec);
+  if(ahead > 0)
+  {
+    wait.tv_sec = ahead / 1000000000LL;
+    wait.tv_nsec = ahead % 1000000000LL;
+    nanosleep(&wait, 0);
+  }
+}
+
+// A character has been shifted in.
+static void sim_rx_done(void)
+{
+  char c;
+
+  c = sim_rx_text[sim_rx_tail++ % SIM_RX_SIZE];
+  sim_rx_bytes++;
+  if(sim_regs[M6811_SCSR] & M6811_RDRF)
+  {
+    sim_regs[M6811_SCSR] |= M6811_OR;
+    sim_rx_lost++;
+    return;
+  }
+  sim_rdr = c;
+  sim_regs[M6811_SCSR] |= M6811_RDRF;
+  if(sim_baud_mismatch())
+  {
+    sim_regs[M6811_SCSR] |= M6811_FE;
+    sim_garbled++;
+  }
+}
+
+static void sim_run_event(struct sim_event *ev)
+{
+  const char *p;
+  unsigned char before;
+
+  before = sim_porta();
+  switch(ev->type)
+  {
+    case SIM_EV_PRESS:
+      sim_buttons |= 1 << ev->button;
+      if(ev->button == BUTTON_OPEN || ev->button == BUTTON_CLOSE)
+      {
+        sim_press_at = sim_cycles;
+        sim_button_rti = 0;
+      }
+      break;
+
+    case SIM_EV_RELEASE:
+      sim_buttons &= ~(1 << ev->button);
+      break;
+
+    case SIM_EV_TYPE:
+      for(p = ev->text; *p; p++)
+        if(sim_rx_head - sim_rx_tail < SIM_RX_SIZE)
+          sim_rx_text[sim_rx_head++ % SIM_RX_SIZE] = *p;
+      break;
+
+    case SIM_EV_BAUD:
+      sim_term_baud = ev->baud;
+      break;
+
+    case SIM_EV_TRAVEL:
+      // Keep the shutter at the same place along its travel.
+      sim_pos = (long double) sim_pos * (ev->travel[0] * ev->travel[1])
+        / (sim_travel[0] * sim_travel[1]);
+      sim_travel[0] = ev->travel[0];
+      sim_travel[1] = ev->travel[1];
+      break;
+
+    case SIM_EV_GLITCH:
+      if(pulse_pins[ev->button].port == M6811_PORTA)
+      {
+        unsigned char pa;
+
+        pa = sim_pa_out;
+        sim_pa_out |= ev->pins;
+        sim_pins(pa);
+      }
+      else
+      {
+        sim_regs[pulse_pins[ev->button].port] |= ev->pins;
+        sim_bridges();
+      }
+      sim_glitch_ch = ev->button;
+      sim_glitch_at = sim_cycles;
+      break;
+
+    case SIM_EV_WIDTH:
+      if(sim_width && !sim_width_seen)
+        sim_width_bad++;
+      sim_width = ev->width * (M6811_CPU_E_CLOCK / 1000000L);
+      sim_width_seen = 0;
+      break;
+
+    case SIM_EV_END:
+      // Handled through sim_end, which -t may override.
+      break;
+  }
+  sim_inputs(before);
+}
+
+// Advance the devices by a number of E clocks.
+static void sim_advance(unsigned long cycles)
+{
+  static const unsigned char prescale[4] = { 1, 4, 8, 16 };
+
+  while(cycles--)
+  {
+    sim_cycles++;
+
+    if(++sim_presc >= prescale[sim_regs[M6811_TMSK2] & (M6811_PR1 | M6811_PR0)])
+    {
+      sim_presc = 0;
+      sim_timer_tick();
+      sim_coils(prescale[sim_regs[M6811_TMSK2] & (M6811_PR1 | M6811_PR0)]);
+    }
+
+    if(sim_travel[0])
+      sim_mech();
+
+    if(--sim_rti_left == 0)
+    {
+      sim_rti_left = (unsigned long) SIM_RTI_CYCLES
+        << (sim_regs[M6811_PACTL] & (M6811_RTR1 | M6811_RTR0));
+      sim_regs[M6811_TFLG2] |= M6811_RTIF;
+      sim_rti_at = sim_cycles;
+      if(sim_pty >= 0)
+        sim_pty_poll();
+    }
+
+    // Transmitter: the data register moves to the shifter as soon as
+    // the shifter is free.
+    if(sim_tx_left && --sim_tx_left == 0)
+      sim_tx_done();
+    if(sim_tx_left == 0)
+    {
+      if(sim_tdr_full && (sim_regs[M6811_SCCR2] & M6811_TE))
+      {
+        sim_tx_shift = sim_tdr;
+        sim_tdr_full = 0;
+        sim_tx_left = sim_char_cycles();
+        sim_regs[M6811_SCSR] |= M6811_TDRE;
+      }
+      else if(!sim_tdr_full)
+        sim_regs[M6811_SCSR] |= M6811_TC;
+    }
+
+    // Receiver: the typed text arrives back to back.
+    if(sim_rx_left)
+    {
+      if(--sim_rx_left == 0)
+        sim_rx_done();
+    }
+    else if(sim_rx_tail != sim_rx_head && (sim_regs[M6811_SCCR2] & M6811_RE))
+      sim_rx_left = sim_char_cycles();
+
+    while(sim_next_event < sim_nevents
+          && sim_events[sim_next_event].at <= sim_cycles)
+      sim_run_event(&sim_events[sim_next_event++]);
+
+    if(sim_cycles >= sim_end || sim_stop)
+      sim_finish(0);
+  }
+}
+
+// Highest priority interrupt request that is enabled, or -1.
+static int sim_pending(void)
+{
+  unsigned char t1, t2, scsr, sccr2;
+
+  t2 = sim_regs[M6811_TFLG2] & sim_regs[M6811_TMSK2];
+  if(t2 & M6811_RTIF)
+    return RTI_VECTOR;
+
+  t1 = sim_regs[M6811_TFLG1] & sim_regs[M6811_TMSK1];
+  if(t1 & M6811_IC1F)
+    return TIMER_INPUT1_VECTOR;
+  if(t1 & M6811_IC2F)
+    return TIMER_INPUT2_VECTOR;
+  if(t1 & M6811_IC3F)
+    return TIMER_INPUT3_VECTOR;
+  if(t1 & M6811_OC1F)
+    return TIMER_OUTPUT1_VECTOR;
+  if(t1 & M6811_OC2F)
+    return TIMER_OUTPUT2_VECTOR;
+  if(t1 & M6811_OC3F)
+    return TIMER_OUTPUT3_VECTOR;
+  if(t1 & M6811_OC4F)
+    return TIMER_OUTPUT4_VECTOR;
+  if(t1 & M6811_OC5F)
+    return TIMER_OUTPUT5_VECTOR;
+
+  if(t2 & M6811_TOF)
+    return TIMER_OVERFLOW_VECTOR;
+
+  scsr = sim_regs[M6811_SCSR];
+  sccr2 = sim_regs[M6811_SCCR2];
+  if(((sccr2 & M6811_TIE) && (scsr & M6811_TDRE))
+     || ((sccr2 & M6811_TCIE) && (scsr & M6811_TC))
+     || ((sccr2 & M6811_RIE) && (scsr & (M6811_RDRF | M6811_OR))))
+    return SCI_VECTOR;
+
+  return -1;
+}
+
+// Take one interrupt.  The handler runs single stepped like the rest
+// of the firmware.
+static void sim_dispatch(int vector)
+{
+  unsigned long long start;
+  unsigned char events;
+  int base = 0;
+
+  if(sim_vectors[vector] == 0)
+  {
+    fprintf(stderr, "sim: no handler for interrupt vector %d\n", vector);
+    sim_finish(1);
+  }
+
+  start = sim_cycles;
+  events = sched_events;
+  sim_advance(SIM_IRQ_CYCLES);
+
+  if(sim_profile)
+    base = sim_prof_enter();
+  sim_imask = 1;
+  sim_trace(1);
+  sim_vectors[vector]();
+  sim_trace(0);
+  sim_imask = 0;
+  if(sim_profile)
+    sim_prof_leave(base);
+
+  sim_irq_count[vector]++;
+  sim_irq_cycles[vector] += sim_cycles - start;
+  if(sim_profile)
+    sim_prof_charge(sim_vectors[vector], SIM_IRQ_CYCLES);
+
+  // The RTI that turned a press into a button event.
+  if(vector == RTI_VECTOR && sim_press_at && !sim_button_rti
+     && (sched_events & ~events & SCHED_EV_BUTTON))
+    sim_button_rti = sim_rti_at;
+}
+
+static void sim_service(void)
+{
+  int vector;
+
+  while(!sim_imask && (vector = sim_pending()) >= 0)
+    sim_dispatch(vector);
+}
+
+// Load the register values the firmware is about to see.
+static void sim_io_load(void)
+{
+  memcpy(&sim_regs[M6811_TCNT], &sim_tcnt, sizeof (sim_tcnt));
+  sim_regs[M6811_PORTA] = sim_porta();
+  sim_regs[M6811_PORTE] = sim_buttons & BUTTON_MASK_E;
+  sim_regs[M6811_SCDR] = sim_rdr;
+  sim_regs[M6811_CFORC] = 0;
+  if(sim_regs[M6811_OPTION] & M6811_ADPU)
+  {
+    int ch;
+
+    for(ch = 0; ch < ADC_CHANNELS; ch++)
+      sim_regs[M6811_ADR1 + ch] = sim_adc(sim_coil_ma[ch], ADC_I_FULL_MA);
+    sim_regs[M6811_ADR1 + ADC_SUPPLY] = sim_adc(sim_supply(), ADC_V_FULL_MV);
+  }
+  memcpy((void *) _io_ports, sim_regs, M6811_IO_SIZE);
+}
+
+// Return != 0 if BPROT protects an EEPROM byte.  The blocks are 32, 64,
+// 128 and 288 bytes long.
+static int sim_ee_protected(unsigned short addr)
+{
+  int block;
+
+  block = addr < 0x20 ? 0 : addr < 0x60 ? 1 : addr < 0xE0 ? 2 : 3;
+  return (sim_regs[M6811_BPROT] >> block) & 1;
+}
+
+// PPROG write.  The step takes place when EEPGM goes off.
+static void sim_pprog(unsigned char val)
+{
+  unsigned char old;
+
+  old = sim_regs[M6811_PPROG];
+  sim_regs[M6811_PPROG] = val;
+
+  if((val & M6811_EEPGM) && !(old & M6811_EEPGM))
+  {
+    // EELAT must be set, and a byte latched, before EEPGM.
+    if(!(old & M6811_EELAT) || !sim_ee_latched)
+      sim_ee_errors++;
+    sim_ee_pgm_at = sim_cycles;
+    return;
+  }
+  if(!(old & M6811_EEPGM) || (val & M6811_EEPGM))
+  {
+    if(!(val & M6811_EELAT))
+      sim_ee_latched = 0;
+    return;
+  }
+
+  if(!sim_ee_latched || !(old & M6811_EELAT) || sim_ee_protected(sim_ee_addr)
+     || sim_cycles - sim_ee_pgm_at
+        < EE_PROG_US * (M6811_CPU_E_CLOCK / 1000000L))
+    sim_ee_errors++;
+  else if(!(old & M6811_ERASE))
+  {
+    sim_eeprom[sim_ee_addr] &= sim_ee_data;
+    sim_ee_programs++;
+  }
+  else if(old & M6811_BYTE)
+  {
+    sim_eeprom[sim_ee_addr] = 0xff;
+    sim_ee_erases++;
+  }
+  else
+    sim_ee_errors++;                    // row and bulk erase are not modelled
+  if(!(val & M6811_EELAT))
+    sim_ee_latched = 0;
+}
+
+// Write one register.
+static void sim_io_write(int reg, unsigned char val)
+{
+  unsigned char before, mask;
+  int n;
+
+  switch(reg)
+  {
+    case M6811_PORTA:
+      // Pins connected to an output compare ignore the port.
+      mask = PA3 | PA4 | PA5 | PA6 | PA7;
+      for(n = 2; n <= 5; n++)
+        if((sim_regs[M6811_TCTL1] >> (2 * (5 - n))) & 3)
+          mask &= ~(PA6 >> (n - 2));
+      before = sim_pa_out;
+      sim_pa_out = (sim_pa_out & ~mask) | (val & mask);
+      sim_pins(before);
+      break;
+
+    case M6811_PORTD:
+      sim_regs[reg] = val;
+      sim_bridges();
+      break;
+
+    case M6811_PPROG:
+      sim_pprog(val);
+      break;
+
+    case M6811_BPROT:
+      if(sim_cycles < SIM_BPROT_CYCLES)
+        sim_regs[reg] = val;
+      break;
+
+    case M6811_CFORC:
+      if(val & M6811_FOC1)
+        sim_oc1_action();
+      for(n = 2; n <= 5; n++)
+        if(val & (M6811_FOC1 >> (n - 1)))
+          sim_oc_action(n);
+      break;
+
+    case M6811_TFLG1:
+    case M6811_TFLG2:
+      sim_regs[reg] &= ~val;
+      break;
+
+    case M6811_SCDR:
+      sim_tdr = val;
+      sim_tdr_full = 1;
+      sim_regs[M6811_SCSR] &= ~(M6811_TDRE | M6811_TC);
+      break;
+
+    case M6811_TCNT_H:
+    case M6811_TCNT_L:
+    case M6811_SCSR:
+      break;
+
+    default:
+      sim_regs[reg] = val;
+      break;
+  }
+}
+
+// The instruction that accessed the I/O page has completed.
+static void sim_io_done(void)
+{
+  unsigned char page[M6811_IO_SIZE];
+  int reg, i;
+
+  memcpy(page, (void *) _io_ports, M6811_IO_SIZE);
+  reg = sim_access - _io_ports;
+
+  if(!sim_access_write)
+  {
+    // Reading SCDR (after SCSR) clears the receive flags.
+    if(reg == M6811_SCDR)
+      sim_regs[M6811_SCSR] &= ~(M6811_RDRF | M6811_OR | M6811_FE);
+    return;
+  }
+
+  for(i = 0; i < M6811_IO_SIZE; i++)
+    if(i == reg || page[i] != sim_regs[i])
+      sim_io_write(i, page[i]);
+}
+
+// HD44780 status and data as read by the firmware.
+static void sim_lcd_load(void)
+{
+  sim_lcd_page[0] = (sim_cycles < sim_lcd_ready ? LCD_BUSY : 0) | sim_ac;
+  sim_lcd_page[1] = sim_ddram[sim_ac];
+}
+
+static void sim_lcd_done(void)
+{
+  unsigned char val;
+  unsigned long us;
+
+  if(!sim_access_write)
+    return;
+
+  if(sim_cycles < sim_lcd_ready)
+    sim_lcd_violations++;
+  sim_lcd_bytes++;
+
+  us = SIM_LCD_US;
+  if(sim_access == &sim_lcd_page[1])
+  {
+    sim_ddram[sim_ac] = sim_lcd_page[1];
+    sim_ac = (sim_ac + 1) & 0x7f;
+  }
+  else
+  {
+    val = sim_lcd_page[0];
+    if(val & 0x80)
+      sim_ac = val & 0x7f;
+    else if(val == 0x01)
+    {
+      memset(sim_ddram, ' ', sizeof (sim_ddram));
+      sim_ac = 0;
+      us = SIM_LCD_HOME_US;
+    }
+    else if((val & 0xfe) == 0x02)
+    {
+      sim_ac = 0;
+      us = SIM_LCD_HOME_US;
+    }
+  }
+  sim_lcd_ready = sim_cycles + us * (M6811_CPU_E_CLOCK / 1000000L);
+}
+
+// EEPROM contents as read by the firmware.
+static void sim_ee_load(void)
+{
+  memcpy((void *) sim_ee_page, sim_eeprom, EE_SIZE);
+  if(!sim_access_write && (sim_regs[M6811_PPROG] & M6811_EELAT))
+    sim_ee_errors++;
+}
+
+// A write to the EEPROM latches the address and data for the next step.
+static void sim_ee_done(void)
+{
+  unsigned short addr;
+
+  if(!sim_access_write)
+    return;
+
+  addr = sim_access - sim_ee_page;
+  if(!(sim_regs[M6811_PPROG] & M6811_EELAT) || addr >= EE_SIZE
+     || (sim_regs[M6811_PPROG] & M6811_EEPGM))
+  {
+    sim_ee_errors++;
+    return;
+  }
+  sim_ee_addr = addr;
+  sim_ee_data = sim_ee_page[addr];
+  sim_ee_latched = 1;
+}
+
+static void sim_segv(int sig, siginfo_t *info, void *context)
+{
+  ucontext_t *uc = context;
+  volatile unsigned char *addr = info->si_addr;
+
+  if(addr >= _io_ports && addr < _io_ports + SIM_PAGE)
+    sim_access_page = _io_ports;
+  else if(addr >= sim_lcd_page && addr < sim_lcd_page + SIM_PAGE)
+    sim_access_page = sim_lcd_page;
+  else if(addr >= sim_ee_page && addr < sim_ee_page + SIM_PAGE)
+    sim_access_page = sim_ee_page;
+  else
+  {
+    fprintf(stderr, "sim: firmware fault at %p (pc %#llx)\n", (void *) addr,
+            (unsigned long long) uc->uc_mcontext.gregs[REG_RIP]);
+    signal(SIGSEGV, SIG_DFL);
+    return;
+  }
+
+  sim_access = addr;
+  sim_access_write = (uc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE) != 0;
+  sim_access_traced = (uc->uc_mcontext.gregs[REG_EFL] & SIM_TF) != 0;
+
+  mprotect((void *) sim_access_page, SIM_PAGE, PROT_READ | PROT_WRITE);
+  if(sim_access_page == _io_ports)
+    sim_io_load();
+  else if(sim_access_page == sim_lcd_page)
+    sim_lcd_load();
+  else
+    sim_ee_load();
+
+  // Come back once the instruction is done.
+  uc->uc_mcontext.gregs[REG_EFL] |= SIM_TF;
+}
+
+static void sim_step(int sig, siginfo_t *info, void *context)
+{
+  ucontext_t *uc = context;
+
+  if(sim_access)
+  {
+    if(sim_access_page == _io_ports)
+      sim_io_done();
+    else if(sim_access_page == sim_lcd_page)
+      sim_lcd_done();
+    else
+      sim_ee_done();
+    mprotect((void *) sim_access_page, SIM_PAGE, PROT_NONE);
+    sim_access = 0;
+
+    if(!sim_access_traced)
+    {
+      uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_TF;
+      return;
+    }
+  }
+
+  sim_insns++;
+  if(sim_profile)
+    sim_prof_step(uc, sim_insn_cycles);
+  sim_advance(sim_insn_cycles);
+  sim_service();
+}
+
+unsigned short sim_lock(void)
+{
+  unsigned short mask;
+
+  sim_trace(0);
+  mask = sim_imask ? M6811_I_BIT << 8 : 0;
+  sim_imask = 1;
+  sim_trace(1);
+  return mask;
+}
+
+void sim_restore(unsigned short mask)
+{
+  sim_trace(0);
+  sim_imask = ((mask >> 8) & M6811_I_BIT) != 0;
+  sim_trace(1);
+}
+
+// CLI then WAI.  An interrupt already pending is taken first; WAI then
+// waits for the next one, as on the HC11.
+void sim_wait(void)
+{
+  unsigned long long start;
+
+  sim_trace(0);
+  sim_imask = 0;
+  sim_service();
+
+  sim_advance(SIM_WAI_CYCLES);
+  start = sim_cycles;
+  while(sim_pending() < 0)
+    sim_advance(1);
+  sim_idle += sim_cycles - start;
+
+  sim_service();
+  sim_trace(1);
+}
+
+void set_interrupt_handler(interrupt_vector_id id, interrupt_t handler)
+{
+  sim_vectors[id] = handler;
+}
+
+static void sim_print_stat(const char *name, struct sim_stat *s)
+{
+  if(s->n == 0)
+  {
+    printf("%-18s none\n", name);
+    return;
+  }
+  printf("%-18s n=%lu  min %.0f us  avg %.0f us  max %.0f us\n", name, s->n,
+         SIM_US(s->min), SIM_US(s->sum / s->n), SIM_US(s->max));
+}
+
+static void sim_report(void)
+{
+  static const struct
+  {
+    int vector;
+    const char *name;
+  } irqs[] =
+  {
+    { RTI_VECTOR,            "rti" },
+    { TIMER_OUTPUT2_VECTOR,  "oc2 (lcd)" },
+    { TIMER_OUTPUT3_VECTOR,  "oc3 (open)" },
+    { TIMER_OUTPUT4_VECTOR,  "oc4 (close)" },
+    { TIMER_OUTPUT5_VECTOR,  "oc5 (adc)" },
+    { TIMER_OUTPUT1_VECTOR,  "oc1 (guard)" },
+    { TIMER_INPUT2_VECTOR,   "ic2 (closed)" },
+    { TIMER_INPUT3_VECTOR,   "ic3 (opened)" },
+    { TIMER_OVERFLOW_VECTOR, "tof" },
+    { SCI_VECTOR,            "sci" }
+  };
+  double secs;
+  unsigned char row, col;
+  unsigned int i;
+
+  secs = sim_cycles / (double) M6811_CPU_E_CLOCK;
+
+  printf("\n\n--- simulation report (%s) ---\n", sim_script ? sim_script : "no script");
+  printf("%-18s %.3f s, %llu E clocks, %lu per instruction\n", "simulated time",
+         secs, sim_cycles, sim_insn_cycles);
+  printf("%-18s %llu\n", "instructions", sim_insns);
+  printf("%-18s %.2f %%\n", "cpu busy",
+         100.0 * (sim_cycles - sim_idle) / (sim_cycles ? sim_cycles : 1));
+  printf("%-18s %lu (%.1f /s)\n", "main loop passes", sched_passes,
+         sched_passes / secs);
+  sim_print_stat("rti to coil", &sim_rti_to_coil);
+  sim_print_stat("press to coil", &sim_press_to_coil);
+  printf("%-18s %lu (%.1f /s), %lu while busy\n", "lcd bytes",
+         sim_lcd_bytes, sim_lcd_bytes / secs, sim_lcd_violations);
+  printf("%-18s %lu (%.1f /s)", "serial tx bytes", sim_tx_bytes,
+         sim_tx_bytes / secs);
+  if(sim_use_pty)
+    printf(", %lu lost", sim_tx_lost);
+  printf("\n");
+  printf("%-18s %lu, %lu overrun\n", "serial rx bytes", sim_rx_bytes,
+         sim_rx_lost);
+  if(sim_garbled)
+    printf("%-18s %lu\n", "baud mismatches", sim_garbled);
+  printf("%-18s %lu\n", "shoot-through", sim_shoot_through);
+  printf("%-18s %lu programmed, %lu erased, %lu errors\n", "eeprom bytes",
+         sim_ee_programs, sim_ee_erases, sim_ee_errors);
+  if(sim_travel[0])
+  {
+    sim_print_stat("open travel", &sim_travel_stat[0]);
+    sim_print_stat("close travel", &sim_travel_stat[1]);
+    printf("%-18s %lu\n", "drives too short", sim_travel_short);
+  }
+  if(sim_glitch_stat.n || sim_glitch_ch >= 0)
+  {
+    sim_print_stat("glitch to off", &sim_glitch_stat);
+    if(sim_glitch_ch >= 0)
+      printf("%-18s channel %d still on\n", "glitch", sim_glitch_ch + 1);
+  }
+  if(sim_width_stat.n || sim_width)
+  {
+    sim_print_stat("width error", &sim_width_stat);
+    printf("%-18s %lu over 1 tick or missing\n", "width checks",
+           sim_width_bad);
+  }
+  printf("%-18s %lu", "coil pulses", sim_coil_pulses);
+  if(sim_coil_pulses)
+    printf(", avg %.0f mJ, peak %.0f mA", sim_coil_mj / sim_coil_pulses,
+           sim_coil_peak);
+  printf("\n");
+
+  for(i = 0; i < sizeof (irqs) / sizeof (irqs[0]); i++)
+  {
+    unsigned long n = sim_irq_count[irqs[i].vector];
+
+    printf("irq %-14s %lu", irqs[i].name, n);
+    if(n)
+      printf(", avg %.1f us", SIM_US((double) sim_irq_cycles[irqs[i].vector] / n));
+    printf("\n");
+  }
+
+  for(row = 0; row < LCD_ROWS; row++)
+  {
+    static const unsigned char base[LCD_ROWS] = { 0x00, 0x40, 0x14, 0x54 };
+
+    printf("lcd |");
+    for(col = 0; col < LCD_COLS; col++)
+      putchar(sim_ddram[base[row] + col]);
+    printf("|\n");
+  }
+}
+
+// Load the EEPROM from the -e file, or leave it erased.
+static void sim_ee_read(void)
+{
+  FILE *f;
+
+  memset(sim_eeprom, 0xff, EE_SIZE);
+  if(sim_ee_file == 0 || (f = fopen(sim_ee_file, "rb")) == 0)
+    return;
+  if(fread(sim_eeprom, 1, EE_SIZE, f) != EE_SIZE)
+    fprintf(stderr, "sim: %s: short EEPROM image\n", sim_ee_file);
+  fclose(f);
+}
+
+static int sim_ee_save(void)
+{
+  FILE *f;
+
+  f = fopen(sim_ee_file, "wb");
+  if(f == 0 || fwrite(sim_eeprom, 1, EE_SIZE, f) != EE_SIZE)
+  {
+    perror(sim_ee_file);
+    if(f)
+      fclose(f);
+    return 1;
+  }
+  return fclose(f) != 0;
+}
+
+// Open the pseudo terminal for -s.  The slave side is kept open in raw
+// mode so a host program can come and go.
+static void sim_pty_open(void)
+{
+  struct termios tio;
+  const char *name;
+  int slave;
+
+  sim_pty = posix_openpt(O_RDWR | O_NOCTTY);
+  if(sim_pty < 0 || grantpt(sim_pty) || unlockpt(sim_pty)
+     || (name = ptsname(sim_pty)) == 0
+     || (slave = open(name, O_RDWR | O_NOCTTY)) < 0)
+  {
+    perror("sim: pseudo terminal");
+    exit(2);
+  }
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fcntl(sim_pty, F_SETFL, O_NONBLOCK);
+
+  fprintf(stderr, "sim: serial line on %s\n", name);
+  clock_gettime(CLOCK_MONOTONIC, &sim_pty_start);
+}
+
+static void sim_interrupted(int sig)
+{
+  sim_stop = 1;
+}
+
+static void sim_finish(int status)
+{
+  sim_trace(0);
+  if(sim_width && !sim_width_seen)
+    sim_width_bad++;
+  sim_report();
+  if(sim_width_bad && status == 0)
+    status = 1;
+  if(sim_ee_file && sim_ee_save() && status == 0)
+    status = 1;
+  if(sim_profile)
+  {
+    sim_prof_report(stdout, sim_cycles);
+    if(sim_prof_json(sim_profile, sim_cycles) && status == 0)
+      status = 1;
+  }
+  fflush(stdout);
+  exit(status);
+}
+
+// Parse a button name or number.
+static int sim_button(const char *name)
+{
+  if(strcmp(name, "open") == 0)
+    return BUTTON_OPEN;
+  if(strcmp(name, "close") == 0)
+    return BUTTON_CLOSE;
+  if(strcmp(name, "clear") == 0)
+    return BUTTON_CLEAR;
+  if(name[0] >= '0' && name[0] < '0' + BUTTON_COUNT && name[1] == 0)
+    return name[0] - '0';
+  return -1;
+}
+
+// Parse "open_ms[,close_ms]" into E clocks.  Returns 0 if it is not
+// valid.
+static int sim_travel_times(const char *s, unsigned long long travel[2])
+{
+  char *end;
+
+  travel[0] = strtod(s, &end) * (M6811_CPU_E_CLOCK / 1000L);
+  travel[1] = travel[0];
+  if(*end == ',')
+    travel[1] = strtod(end + 1, &end) * (M6811_CPU_E_CLOCK / 1000L);
+  return *end == 0 && travel[0] != 0 && travel[1] != 0;
+}
+
+// Parse "<ch> open|close|both" into the channel and its pins.  Returns
+// 0 if it is not valid.
+static int sim_glitch_pins(const char *s, struct sim_event *ev)
+{
+  char half[8];
+  int ch;
+
+  if(sscanf(s, "%d %7s", &ch, half) != 2 || ch < 1 || ch > PULSE_CHANNELS)
+    return 0;
+  ev->button = ch - 1;
+  ev->pins = 0;
+  if(strcmp(half, "open") == 0 || strcmp(half, "both") == 0)
+    ev->pins |= pulse_pins[ch - 1].open;
+  if(strcmp(half, "close") == 0 || strcmp(half, "both") == 0)
+    ev->pins |= pulse_pins[ch - 1].close;
+  return ev->pins != 0;
+}
+
+// Copy text with \r, \n and \\ escapes.
+static char *sim_unescape(const char *s)
+{
+  char *text, *d;
+
+  text = d = malloc(strlen(s) + 1);
+  for(; *s; s++)
+  {
+    if(*s == '\\' && s[1])
+    {
+      s++;
+      *d++ = *s == 'r' ? '\r' : *s == 'n' ? '\n' : *s;
+    }
+    else
+      *d++ = *s;
+  }
+  *d = 0;
+  return text;
+}
+
+static void sim_load(const char *name)
+{
+  FILE *f;
+  char line[256], action[16];
+  char *arg, *end;
+  unsigned long ms;
+  int lineno, skip, button;
+  struct sim_event *ev;
+
+  f = fopen(name, "r");
+  if(f == 0)
+  {
+    perror(name);
+    exit(2);
+  }
+
+  for(lineno = 1; fgets(line, sizeof (line), f); lineno++)
+  {
+    line[strcspn(line, "\r\n")] = 0;
+    if(line[strspn(line, " \t")] == '#')
+      continue;
+    if(sscanf(line, "%lu %15s %n", &ms, action, &skip) < 2)
+    {
+      if(line[strspn(line, " \t")] == 0)
+        continue;
+      goto bad;
+    }
+
+    // The argument is the rest of the line, without trailing blanks.
+    arg = line + skip;
+    end = arg + strlen(arg);
+    while(end > arg && (end[-1] == ' ' || end[-1] == '\t'))
+      *--end = 0;
+
+    if(sim_nevents == SIM_MAX_EVENTS)
+      goto bad;
+    ev = &sim_events[sim_nevents];
+    ev->at = (unsigned long long) ms * (M6811_CPU_E_CLOCK / 1000L);
+    if(sim_nevents && ev->at < sim_events[sim_nevents - 1].at)
+      goto bad;
+
+    if(strcmp(action, "press") == 0 || strcmp(action, "release") == 0)
+    {
+      button = sim_button(arg);
+      if(button < 0)
+        goto bad;
+      ev->type = action[0] == 'p' ? SIM_EV_PRESS : SIM_EV_RELEASE;
+      ev->button = button;
+    }
+    else if(strcmp(action, "type") == 0 && *arg)
+    {
+      ev->type = SIM_EV_TYPE;
+      ev->text = sim_unescape(arg);
+    }
+    else if(strcmp(action, "baud") == 0 && *arg)
+    {
+      ev->type = SIM_EV_BAUD;
+      ev->baud = strtoul(arg, &end, 10);
+      if(*end || ev->baud == 0)
+        goto bad;
+    }
+    else if(strcmp(action, "travel") == 0 && sim_travel[0])
+    {
+      ev->type = SIM_EV_TRAVEL;
+      if(!sim_travel_times(arg, ev->travel))
+        goto bad;
+    }
+    else if(strcmp(action, "glitch") == 0)
+    {
+      ev->type = SIM_EV_GLITCH;
+      if(!sim_glitch_pins(arg, ev))
+        goto bad;
+    }
+    else if(strcmp(action, "width") == 0 && *arg)
+    {
+      ev->type = SIM_EV_WIDTH;
+      ev->width = strtoul(arg, &end, 10);
+      if(*end || ev->width == 0)
+        goto bad;
+    }
+    else if(strcmp(action, "end") == 0)
+    {
+      ev->type = SIM_EV_END;
+      sim_end = ev->at;
+    }
+    else
+      goto bad;
+    sim_nevents++;
+  }
+  fclose(f);
+  return;
+
+bad:
+  fprintf(stderr, "%s:%d: bad event \"%s\"\n", name, lineno, line);
+  exit(2);
+}
+
+// Set up the board before main runs.  The firmware starts with the
+// first lock(), which also starts single stepping.
+static void __attribute__((constructor)) sim_init(int argc, char **argv)
+{
+  struct sigaction sa;
+  int opt;
+  long end_ms = -1;
+
+  while((opt = getopt(argc, argv, "qsc:t:p:e:m:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'q':
+        sim_quiet = 1;
+        break;
+      case 's':
+        sim_use_pty = 1;
+        break;
+      case 'c':
+        sim_insn_cycles = strtoul(optarg, 0, 0);
+        break;
+      case 't':
+        end_ms = strtol(optarg, 0, 0);
+        break;
+      case 'p':
+        sim_profile = optarg;
+        break;
+      case 'e':
+        sim_ee_file = optarg;
+        break;
+      case 'm':
+        if(!sim_travel_times(optarg, sim_travel))
+        {
+          fprintf(stderr, "sim: bad travel times \"%s\"\n", optarg);
+          exit(2);
+        }
+#ifndef SENSE_ENABLE
+        fprintf(stderr, "sim: -m needs a SENSE=1 build\n");
+        exit(2);
+#endif
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-q] [-s] [-c cycles] [-t ms] [-p json] [-e file] [-m open_ms[,close_ms]] [script]\n", argv[0]);
+        exit(2);
+    }
+  }
+
+  sim_end = sim_use_pty ? ~0ULL
+    : (unsigned long long) SIM_END_MS * (M6811_CPU_E_CLOCK / 1000L);
+  if(optind < argc)
+  {
+    sim_script = argv[optind];
+    sim_load(sim_script);
+  }
+  if(end_ms >= 0)
+    sim_end = (unsigned long long) end_ms * (M6811_CPU_E_CLOCK / 1000L);
+
+  if(sim_profile)
+    sim_prof_init();
+  if(sim_use_pty)
+  {
+    sim_pty_open();
+    signal(SIGINT, sim_interrupted);
+    signal(SIGTERM, sim_interrupted);
+  }
+
+  // Reset state.
+  sim_imask = 1;
+  sim_regs[M6811_SCSR] = M6811_TDRE | M6811_TC;
+  sim_regs[M6811_BPROT] = SIM_BPROT_RESET;
+  sim_rti_left = SIM_RTI_CYCLES;
+  memset(sim_ddram, ' ', sizeof (sim_ddram));
+  sim_ee_read();
+  if(sim_travel[0])
+    sim_sense = SENSE_CLOSED_PIN;       // the shutter starts closed
+
+  memset(&sa, 0, sizeof (sa));
+  sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sa.sa_sigaction = sim_segv;
+  sigaction(SIGSEGV, &sa, 0);
+  sa.sa_sigaction = sim_step;
+  sigaction(SIGTRAP, &sa, 0);
+
+  mprotect((void *) _io_ports, SIM_PAGE, PROT_NONE);
+  mprotect((void *) sim_lcd_page, SIM_PAGE, PROT_NONE);
+  mprotect((void *) sim_ee_page, SIM_PAGE, PROT_NONE);
+}
@@ -0,0 +1,24 @@
+/*  Filename:       sim.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Interface between the parts of the host simulator.
+*/
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdio.h>
+#include <ucontext.h>
+
+/* Per-function profile (prof.c).  */
+extern void sim_prof_init (void);
+extern void sim_prof_step (const ucontext_t *uc, unsigned long cycles);
+extern int sim_prof_enter (void);
+extern void sim_prof_leave (int base);
+extern void sim_prof_charge (void (*handler) (void), unsigned long cycles);
+extern void sim_prof_report (FILE *out, unsigned long long cycles);
+extern int sim_prof_json (const char *name, unsigned long long cycles);
+
+#endif
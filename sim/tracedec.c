@@ -0,0 +1,255 @@
+/*  Filename:       tracedec.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC (Linux x86-64)
+    Description:    Decoder for the dumps of the trace buffer (see trace.h).
+    It reads a capture of the serial line, finds the dumps in it (the rest
+    of the console output is skipped), and prints each one as a timeline
+    followed by statistics:
+
+    - the time spent between the start and end of each traced section
+    - the interval between two RTI entries
+    - the time from a button press to the start of its pulse
+
+    Usage: tracedec [-q] [capture]
+      -q   statistics only, no timeline
+    The capture is read from stdin when no file is given.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/* TCNT runs at the E clock (2MHz) divided by 16.  */
+#define TICK_US         8
+
+struct dec_stat
+{
+  const char *name;
+  unsigned long count;
+  unsigned long min;
+  unsigned long max;
+  unsigned long long sum;
+};
+
+static const char *dec_name(unsigned char id, char *buf)
+{
+  switch(id)
+  {
+    case TRACE_RTI:         return "rti";
+    case TRACE_RTI_END:     return "rti end";
+    case TRACE_CLOCK:       return "clock";
+    case TRACE_CLOCK_END:   return "clock end";
+    case TRACE_FLUSH:       return "lcd flush";
+    case TRACE_FLUSH_END:   return "lcd flush end";
+  }
+  if((id & 0xF0) == TRACE_OPEN)
+  {
+    static const char *const names[4] =
+    {
+      "open pulse", "opened", "close pulse", "closed"
+    };
+
+    sprintf(buf, "%s %d", names[id & 3], (id >> 2) & 3);
+  }
+  else if((id & 0xF0) == TRACE_PRESS)
+    sprintf(buf, "press %d", id & 0x0F);
+  else
+    sprintf(buf, "id 0x%02x", id);
+  return buf;
+}
+
+static void stat_add(struct dec_stat *s, unsigned long us)
+{
+  if(s->count == 0 || us < s->min)
+    s->min = us;
+  if(us > s->max)
+    s->max = us;
+  s->sum += us;
+  s->count++;
+}
+
+static void stat_print(const struct dec_stat *s)
+{
+  if(s->count == 0)
+    return;
+  printf("%-20s %6lu %8lu %8.1f %8lu\n", s->name, s->count, s->min,
+         (double) s->sum / s->count, s->max);
+}
+
+// Decode one dump of count records.
+static void dec_dump(const unsigned char *rec, int count, int timeline)
+{
+  static const unsigned char sections[] =
+  {
+    TRACE_RTI, TRACE_CLOCK, TRACE_FLUSH
+  };
+  struct dec_stat sect[sizeof (sections)];
+  struct dec_stat period, open, close;
+  unsigned long start[sizeof (sections)];
+  int open_start[sizeof (sections)];
+  unsigned long now, last_rti, press_open, press_close;
+  unsigned short t, prev;
+  unsigned char id;
+  char buf[16];
+  int i, k, have_rti, have_open, have_close;
+
+  memset(sect, 0, sizeof (sect));
+  memset(&period, 0, sizeof (period));
+  memset(&open, 0, sizeof (open));
+  memset(&close, 0, sizeof (close));
+  memset(open_start, 0, sizeof (open_start));
+  for(k = 0; k < (int) sizeof (sections); k++)
+    sect[k].name = dec_name(sections[k], buf);
+  period.name = "rti period";
+  open.name = "press to open";
+  close.name = "press to close";
+
+  if(timeline)
+    printf("\n%10s %8s  %s\n", "us", "+us", "event");
+
+  now = last_rti = press_open = press_close = 0;
+  have_rti = have_open = have_close = 0;
+  prev = 0;
+  for(i = 0; i < count; i++)
+  {
+    id = rec[i * 3];
+    t = (rec[i * 3 + 1] << 8) | rec[i * 3 + 2];
+    if(i > 0)
+      now += (unsigned short) (t - prev) * TICK_US;
+    if(timeline)
+      printf("%10lu %8lu  %s\n", now,
+             i > 0 ? (unsigned short) (t - prev) * TICK_US : 0UL,
+             dec_name(id, buf));
+    prev = t;
+
+    for(k = 0; k < (int) sizeof (sections); k++)
+    {
+      if(id == sections[k])
+      {
+        start[k] = now;
+        open_start[k] = 1;
+      }
+      else if(id == sections[k] + 1 && open_start[k])
+      {
+        stat_add(&sect[k], now - start[k]);
+        open_start[k] = 0;
+      }
+    }
+
+    switch(id)
+    {
+      case TRACE_RTI:
+        if(have_rti)
+          stat_add(&period, now - last_rti);
+        last_rti = now;
+        have_rti = 1;
+        break;
+
+      case TRACE_PRESS + 0:
+        press_open = now;
+        have_open = 1;
+        break;
+
+      case TRACE_PRESS + 1:
+        press_close = now;
+        have_close = 1;
+        break;
+
+      case TRACE_OPEN:
+        if(have_open)
+          stat_add(&open, now - press_open);
+        have_open = 0;
+        break;
+
+      case TRACE_CLOSE:
+        if(have_close)
+          stat_add(&close, now - press_close);
+        have_close = 0;
+        break;
+    }
+  }
+
+  printf("\n%-20s %6s %8s %8s %8s\n", "us", "count", "min", "avg", "max");
+  for(k = 0; k < (int) sizeof (sections); k++)
+    stat_print(&sect[k]);
+  stat_print(&period);
+  stat_print(&open);
+  stat_print(&close);
+}
+
+int main(int argc, char **argv)
+{
+  FILE *f;
+  unsigned char *data;
+  size_t len, size;
+  size_t i;
+  int timeline, count, dumps, n;
+  unsigned char sum;
+
+  timeline = 1;
+  if(argc > 1 && strcmp(argv[1], "-q") == 0)
+  {
+    timeline = 0;
+    argc--;
+    argv++;
+  }
+
+  f = stdin;
+  if(argc > 1)
+  {
+    f = fopen(argv[1], "rb");
+    if(f == 0)
+    {
+      perror(argv[1]);
+      return 2;
+    }
+  }
+
+  size = 4096;
+  len = 0;
+  data = malloc(size);
+  while((n = fread(data + len, 1, size - len, f)) > 0)
+  {
+    len += n;
+    if(len == size)
+    {
+      size *= 2;
+      data = realloc(data, size);
+    }
+  }
+
+  dumps = 0;
+  for(i = 0; i + 3 < len; i++)
+  {
+    if(data[i] != TRACE_SYNC || data[i + 1] != 'T')
+      continue;
+    count = data[i + 2];
+    if(count > TRACE_SIZE || i + 3 + count * 3 >= len)
+      continue;
+
+    sum = 0;
+    for(n = 1; n < 3 + count * 3; n++)
+      sum += data[i + n];
+    if(sum != data[i + 3 + count * 3])
+    {
+      fprintf(stderr, "tracedec: bad sum at offset %lu\n", (unsigned long) i);
+      continue;
+    }
+
+    printf("%sdump %d: %d records\n", dumps ? "\n" : "", dumps + 1, count);
+    dec_dump(data + i + 3, count, timeline);
+    dumps++;
+    i += 3 + count * 3;
+  }
+
+  if(dumps == 0)
+  {
+    fprintf(stderr, "tracedec: no trace dump found\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+/*  Filename:       stats.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Latency statistics.
+
+    The RTI and TCNT both count E clocks, so an RTI handler that starts
+    on time always finds the same value in the low bits of TCNT (one RTI
+    period is a power of 2 of TCNT ticks).  How far those bits are past
+    the earliest value seen is how late the handler started, because
+    interrupts were masked or another handler was running.  A sample
+    more than 3/4 of a period late is taken to be early instead and
+    becomes the new reference.
+
+    A press is timed from the RTI sample where the button input first
+    changed, so the debounce time is included, to the TCNT value at
+    which the output compare sets the coil pin.
+*/
+
+#include "ShutterJig.h"
+#include "stats.h"
+
+#define STATS_RTI_MASK  (STATS_RTI_TCNT - 1)
+
+stats_acc_t stats_rti;
+stats_acc_t stats_coil;
+#ifdef SENSE_ENABLE
+stats_acc_t stats_travel[2];
+#endif
+
+// Low bits of TCNT at the earliest RTI entry.
+static unsigned short stats_rti_phase;
+static unsigned char stats_rti_valid;
+
+// Edge of the press waiting for its pulse.
+static unsigned short stats_edge;
+static unsigned char stats_edge_valid;
+
+static void stats_clear(stats_acc_t *acc)
+{
+  unsigned char i;
+
+  acc->count = 0;
+  acc->sum = 0;
+  acc->min = 0xffff;
+  acc->max = 0;
+  for(i = 0; i < STATS_BUCKETS; i++)
+    acc->hist[i] = 0;
+}
+
+// Account for one sample.  Callers have interrupts masked.
+static void stats_add(stats_acc_t *acc, unsigned short val)
+{
+  unsigned short v;
+  unsigned char bucket;
+
+  acc->count++;
+  acc->sum += val;
+  if(val < acc->min)
+    acc->min = val;
+  if(val > acc->max)
+    acc->max = val;
+
+  bucket = 0;
+  for(v = val; v; v >>= 1)
+    bucket++;
+  if(acc->hist[bucket] != 0xffff)
+    acc->hist[bucket]++;
+}
+
+// Clear the statistics.
+void stats_init(void)
+{
+  unsigned short mask;
+
+  mask = lock();
+  stats_clear(&stats_rti);
+  stats_clear(&stats_coil);
+#ifdef SENSE_ENABLE
+  stats_clear(&stats_travel[0]);
+  stats_clear(&stats_travel[1]);
+#endif
+  stats_rti_valid = 0;
+  stats_edge_valid = 0;
+  restore(mask);
+}
+
+// Sample the RTI lateness.  Called first thing by the RTI handler with
+// the TCNT value it found.
+void stats_rti_entry(unsigned short now)
+{
+  unsigned short late;
+
+  late = (now - stats_rti_phase) & STATS_RTI_MASK;
+  if(!stats_rti_valid || late > STATS_RTI_TCNT - STATS_RTI_TCNT / 4)
+  {
+    stats_rti_phase = now & STATS_RTI_MASK;
+    stats_rti_valid = 1;
+    late = 0;
+  }
+  stats_add(&stats_rti, late);
+}
+
+// A press asked for a pulse; edge is the TCNT value of its RTI sample.
+void stats_press(unsigned short edge)
+{
+  stats_edge = edge;
+  stats_edge_valid = 1;
+}
+
+// The pending press did not need a pulse.
+void stats_press_cancel(void)
+{
+  stats_edge_valid = 0;
+}
+
+// A pulse was started with its leading edge at TCNT value on.
+void stats_coil_on(unsigned short on)
+{
+  unsigned short mask;
+
+  if(!stats_edge_valid)
+    return;
+
+  mask = lock();
+  stats_add(&stats_coil, on - stats_edge);
+  restore(mask);
+  stats_edge_valid = 0;
+}
+
+#ifdef SENSE_ENABLE
+// A travel time, 0 for opening and 1 for closing.  Called from the
+// input capture interrupt.
+void stats_travel_add(unsigned char i, unsigned short ticks)
+{
+  stats_add(&stats_travel[i], ticks);
+}
+#endif
+
+// Copy the statistics in one piece.
+void stats_copy(stats_acc_t *copy, const stats_acc_t *acc)
+{
+  unsigned short mask;
+
+  mask = lock();
+  *copy = *acc;
+  restore(mask);
+}
+
+// Mean of the samples, or 0 if there is none.  This takes a 32-bit
+// divide, so it is for the display only.
+unsigned short stats_mean(const stats_acc_t *acc)
+{
+  if(acc->count == 0)
+    return 0;
+  return (unsigned short) (acc->sum / acc->count);
+}
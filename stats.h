@@ -0,0 +1,53 @@
+/*  Filename:       stats.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the latency statistics.
+    Two figures are kept, in TCNT ticks: how late the RTI handler starts
+    compared to the earliest start seen, and the time from a button edge
+    to the leading edge of the pulse it causes.  Each one has a minimum,
+    maximum, mean and a histogram with one bucket per power of 2.  With
+    the end-of-travel sensors (sense.h) the open and close travel times
+    are kept the same way.
+*/
+
+#ifndef _STATS_H
+#define _STATS_H
+
+/* Bucket 0 counts the samples of 0 ticks and bucket k > 0 the samples
+   from 2^(k-1) to 2^k - 1 ticks, which covers every 16-bit value.  */
+#define STATS_BUCKETS   17
+
+/* TCNT ticks in one RTI period.  */
+#define STATS_RTI_TCNT  ((unsigned short) (TIMER_DIV / TCNT_DIV))
+
+/*! Accumulated samples.  The histogram counts stop at 0xFFFF.  */
+struct stats_acc
+{
+  unsigned long count;
+  unsigned long sum;
+  unsigned short min;
+  unsigned short max;
+  unsigned short hist[STATS_BUCKETS];
+};
+typedef struct stats_acc stats_acc_t;
+
+extern stats_acc_t stats_rti;           /* RTI entry lateness */
+extern stats_acc_t stats_coil;          /* button edge to coil on */
+#ifdef SENSE_ENABLE
+extern stats_acc_t stats_travel[2];     /* open and close travel */
+#endif
+
+extern void stats_init (void);
+extern void stats_rti_entry (unsigned short now);
+extern void stats_press (unsigned short edge);
+extern void stats_press_cancel (void);
+extern void stats_coil_on (unsigned short on);
+#ifdef SENSE_ENABLE
+extern void stats_travel_add (unsigned char i, unsigned short ticks);
+#endif
+extern void stats_copy (stats_acc_t *copy, const stats_acc_t *acc);
+extern unsigned short stats_mean (const stats_acc_t *acc);
+
+#endif
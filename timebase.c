@@ -0,0 +1,164 @@
+/*  Filename:       timebase.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Interrupt-safe time readers.  A 32-bit counter takes
+    two 16-bit loads on the HC11, so an interrupt can land between them.
+    Rather than masking interrupts around the read, the readers load the
+    counter twice and retry if an interrupt moved it in between.  The
+    counters only ever go up, so two equal loads cannot hide a torn
+    read.
+
+    The RTI handler also carries the time of day forward by adding the
+    precomputed length of a period, so turning ticks into seconds and
+    microseconds takes a few additions instead of 32-bit multiplies and
+    divides.  Readers of that clock use a sequence count bumped by each
+    update and retry if it changed while they copied the fields.
+*/
+
+#include "ShutterJig.h"
+#include "sched.h"
+#include "buttons.h"
+#include "trace.h"
+#include "stats.h"
+
+// Number of RTI periods since timebase_init.
+static volatile unsigned long timer_count;
+
+// Number of TCNT overflows since timebase_init.
+static volatile unsigned short tb_overflows;
+
+// Clock carried forward by the RTI handler.
+static unsigned long tb_seconds;
+static unsigned long tb_us;
+static unsigned long tb_tenth_mark;     // us value where the next tenth starts
+static unsigned char tb_tenths;
+#if TB_RTI_US_FRAC
+static unsigned short tb_frac;
+#endif
+static volatile unsigned char tb_seq;
+
+// Timer interrupt handler.
+void __attribute__((interrupt)) timer_interrupt(void)
+{
+  SCHED_WAKE();
+  TRACE(TRACE_RTI);
+  stats_rti_entry(get_timer_counter());
+  timer_count++;
+
+  tb_us += TB_RTI_US;
+#if TB_RTI_US_FRAC
+  tb_frac += TB_RTI_US_FRAC;
+  if(tb_frac >= TB_E_KHZ)
+  {
+    tb_frac -= TB_E_KHZ;
+    tb_us++;
+  }
+#endif
+
+  if(tb_us >= 1000000L)
+  {
+    tb_us -= 1000000L;
+    tb_seconds++;
+    tb_tenths = 0;
+    tb_tenth_mark = 100000L;
+  }
+
+  // An RTI period is much shorter than a tenth, so one step is enough.
+  if(tb_us >= tb_tenth_mark)
+  {
+    tb_tenths++;
+    tb_tenth_mark += 100000L;
+  }
+
+  tb_seq++;
+  buttons_sample();
+  pulse_tick();
+  sched_post(SCHED_EV_TICK);
+  timer_acknowledge();
+  TRACE(TRACE_RTI_END);
+}
+
+// Timer overflow interrupt handler.
+void __attribute__((interrupt)) timebase_overflow_interrupt(void)
+{
+  SCHED_WAKE();
+  tb_overflows++;
+  _io_ports[M6811_TFLG2] = M6811_TOF;
+}
+
+// Reset the counters and enable the overflow interrupt.  This must come
+// after timer_initialize_rate, which rewrites TMSK2.
+void timebase_init(void)
+{
+  unsigned short mask;
+
+  mask = lock();
+  timer_count = 0;
+  tb_overflows = 0;
+  tb_seconds = 0;
+  tb_us = 0;
+  tb_tenths = 0;
+  tb_tenth_mark = 100000L;
+#if TB_RTI_US_FRAC
+  tb_frac = 0;
+#endif
+  _io_ports[M6811_TFLG2] = M6811_TOF;
+  _io_ports[M6811_TMSK2] |= M6811_TOI;
+  restore(mask);
+}
+
+// Returns the current number of ticks that ellapsed since we started.
+unsigned long timebase_ticks(void)
+{
+  unsigned long t;
+
+  do
+    t = timer_count;
+  while(t != timer_count);
+  return t;
+}
+
+// Returns the time in TCNT ticks (TB_US_PER_TICK each), as the overflow
+// count above the 16 bits of TCNT.  It wraps after 2^32 ticks.
+unsigned long timebase_now(void)
+{
+  unsigned short hi;
+  unsigned short lo;
+  unsigned short pending;
+
+  do
+  {
+    hi = tb_overflows;
+    lo = get_timer_counter();
+
+    // If TCNT wrapped but the overflow has not been serviced yet (we
+    // are in an interrupt handler, or it is about to be taken), count it.
+    // A small TCNT tells the wrap came before the read.
+    pending = (_io_ports[M6811_TFLG2] & M6811_TOF) && lo < 0x8000;
+  }
+  while(hi != tb_overflows);
+
+  return ((unsigned long) (hi + pending) << 16) | lo;
+}
+
+// Copy the clock.  The fields are not volatile, so the handler can keep
+// them in registers; the barriers stop the compiler from moving their
+// loads outside the two reads of tb_seq.
+void timebase_clock(tb_clock_t *clock)
+{
+  unsigned char seq;
+
+  do
+  {
+    seq = tb_seq;
+    __asm__ __volatile__ ("" : : : "memory");
+    clock->ticks = timer_count;
+    clock->seconds = tb_seconds;
+    clock->us = tb_us;
+    clock->tenths = tb_tenths;
+    __asm__ __volatile__ ("" : : : "memory");
+  }
+  while(seq != tb_seq);
+}
@@ -0,0 +1,43 @@
+/*  Filename:       timebase.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the timebase.  It owns the
+    RTI tick count, the time of day clock kept by the RTI handler, and
+    extends the free running TCNT with an overflow count.  All of them
+    can be read from the foreground without masking interrupts.
+*/
+
+#ifndef _TIMEBASE_H
+#define _TIMEBASE_H
+
+/* Microseconds per TCNT tick.  */
+#define TB_US_PER_TICK  (1000000L / TCNT_RATE)
+
+/* Length of one RTI period in microseconds, as a whole part and a
+   fraction in units of 1/TB_E_KHZ microsecond.  Working in kHz keeps
+   TIMER_DIV * 1000000 from overflowing 32 bits.  */
+#define TB_E_KHZ        (M6811_CPU_E_CLOCK / 1000L)
+#define TB_RTI_US       ((TIMER_DIV * 1000L) / TB_E_KHZ)
+#define TB_RTI_US_FRAC  ((TIMER_DIV * 1000L) % TB_E_KHZ)
+
+/*! Snapshot of the clock kept by the RTI handler.  */
+struct tb_clock
+{
+  unsigned long ticks;                  /* RTI periods since start */
+  unsigned long seconds;                /* seconds since start */
+  unsigned long us;                     /* microseconds in the second */
+  unsigned char tenths;                 /* tenths of second in the second */
+};
+typedef struct tb_clock tb_clock_t;
+
+extern void timer_interrupt (void) __attribute__((interrupt));
+extern void timebase_overflow_interrupt (void) __attribute__((interrupt));
+
+extern void timebase_init (void);
+extern unsigned long timebase_ticks (void);
+extern unsigned long timebase_now (void);
+extern void timebase_clock (tb_clock_t *clock);
+
+#endif
@@ -0,0 +1,121 @@
+/*  Filename:       trace.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Trace buffer.  TRACE(id) (see trace.h) stores an id and
+    the TCNT value in the next slot of a RAM ring, overwriting the oldest
+    record once the ring is full.  A dump stops the recording, sends the
+    ring over the serial line a few records per tick, as room frees up in
+    the TX ring, and then starts a fresh trace.
+
+    TCNT wraps every 524ms, so the decoder can only place records that
+    are closer together than that.  The RTI handler records every 4ms,
+    which keeps the trace continuous.
+*/
+
+#include "ShutterJig.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLE
+
+#define TRACE_MASK      (TRACE_SIZE - 1)
+
+unsigned char trace_id[TRACE_SIZE];
+unsigned short trace_time[TRACE_SIZE];
+unsigned char trace_head;
+volatile unsigned char trace_on;
+
+// Dump in progress: the slot of the next record to send, the records
+// left to send and the sum of what was sent.
+static unsigned char trace_header;
+static unsigned char trace_next;
+static unsigned char trace_left;
+static unsigned char trace_sum;
+static unsigned char trace_sending;
+
+// Empty the ring and start recording.
+void trace_init(void)
+{
+  unsigned char i;
+
+  trace_on = 0;
+  for(i = 0; i < TRACE_SIZE; i++)
+    trace_id[i] = 0;
+  trace_head = 0;
+  trace_sending = 0;
+  trace_on = 1;
+}
+
+// Start a dump.  Records are never id 0, so a slot still at 0 tells
+// that the ring has not wrapped yet.
+void trace_dump(void)
+{
+  if(trace_sending)
+    return;
+
+  trace_on = 0;
+  if(trace_id[trace_head] != 0)
+  {
+    trace_next = trace_head;
+    trace_left = TRACE_SIZE;
+  }
+  else
+  {
+    trace_next = 0;
+    trace_left = trace_head;
+  }
+  trace_header = 1;
+  trace_sum = 0;
+  trace_sending = 1;
+}
+
+// Return != 0 while a dump is being sent.  Other serial output would
+// break up the dump, so it waits.
+unsigned char trace_busy(void)
+{
+  return trace_sending;
+}
+
+static void trace_put(unsigned char c)
+{
+  trace_sum += c;
+  sci_putc(c);
+}
+
+// Send as much of the dump as fits in the TX ring.  Runs on every tick.
+void trace_task(void)
+{
+  unsigned char slot;
+
+  if(!trace_sending)
+    return;
+
+  if(trace_header)
+  {
+    if(sci_tx_free() < 3)
+      return;
+    sci_putc(TRACE_SYNC);
+    trace_put('T');
+    trace_put(trace_left);
+    trace_header = 0;
+  }
+
+  while(trace_left && sci_tx_free() >= 3)
+  {
+    slot = trace_next;
+    trace_put(trace_id[slot]);
+    trace_put(trace_time[slot] >> 8);
+    trace_put(trace_time[slot]);
+    trace_next = (slot + 1) & TRACE_MASK;
+    trace_left--;
+  }
+
+  if(trace_left == 0 && sci_tx_free() >= 1)
+  {
+    sci_putc(trace_sum);
+    trace_init();
+  }
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*  Filename:       trace.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the trace buffer.  TRACE(id)
+    records the id and TCNT in a RAM ring, so the order and timing of the
+    hot paths can be seen on the jig itself.  The T command sends the ring
+    over the serial line and sim/tracedec turns it into a timeline.
+
+    The trace buffer is only built with TRACE_ENABLE defined (make
+    TRACE=1); otherwise TRACE(id) compiles to nothing.
+*/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/* Trace points.  The start and end of a section are an even id and the
+   odd id after it, so the decoder can time the section.  */
+#define TRACE_RTI           0x02        /* timer_interrupt */
+#define TRACE_RTI_END       0x03
+#define TRACE_CLOCK         0x04        /* display_time */
+#define TRACE_CLOCK_END     0x05
+#define TRACE_FLUSH         0x06        /* LCD_Flush */
+#define TRACE_FLUSH_END     0x07
+
+/* Shutter transitions of channel 0; channel n adds 4 * n.  */
+#define TRACE_OPEN          0x10        /* open pulse started */
+#define TRACE_OPENED        0x11        /* open pulse and dead time over */
+#define TRACE_CLOSE         0x12        /* close pulse started */
+#define TRACE_CLOSED        0x13        /* close pulse and dead time over */
+#define TRACE_PRESS         0x20        /* + button number */
+
+/* Number of records in the ring (must be a power of 2).  */
+#define TRACE_SIZE          64
+
+/* A dump is TRACE_SYNC, 'T', the number of records, the records (id,
+   TCNT high, TCNT low) from the oldest and an 8-bit sum of every byte
+   after TRACE_SYNC.  */
+#define TRACE_SYNC          0x02
+
+#ifdef TRACE_ENABLE
+
+extern unsigned char trace_id[TRACE_SIZE];
+extern unsigned short trace_time[TRACE_SIZE];
+extern unsigned char trace_head;
+extern volatile unsigned char trace_on;
+
+extern void trace_init (void);
+extern void trace_dump (void);
+extern void trace_task (void);
+extern unsigned char trace_busy (void);
+
+/* Record a trace point.  Usable from interrupt handlers and from the
+   main loop; the ring is left alone while it is being dumped.  */
+inline static void trace_record (unsigned char id)
+{
+  unsigned short mask;
+  unsigned char head;
+
+  if(!trace_on)
+    return;
+
+  mask = lock();
+  head = trace_head;
+  trace_id[head] = id;
+  trace_time[head] = get_timer_counter();
+  trace_head = (head + 1) & (TRACE_SIZE - 1);
+  restore(mask);
+}
+
+#define TRACE(ID)           trace_record(ID)
+
+#else
+
+#define TRACE(ID)           do { } while(0)
+#define trace_init()        do { } while(0)
+#define trace_busy()        0
+
+#endif
+
+#endif
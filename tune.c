@@ -0,0 +1,139 @@
+/*  Filename:       tune.c
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    Pulse time tuning of channel 0.
+
+    Each direction keeps a travel estimate that takes a longer travel at
+    once and comes down slowly after shorter ones, so it stays near the
+    slowest recent pulse.  The on time is the estimate plus a margin.
+    Since the capture interrupt ends the pulse when the shutter gets
+    there, the on time only matters when it does not, so a short one
+    finds a stall sooner and heats the coil less.  The dead time comes
+    down by a fixed share per pulse, to TUNE_DEAD_MIN_US.
+
+    A pulse that does not get there with tuned times is a miss rather
+    than a fault: the margin and the times double, within the times set
+    with P, they stay there for TUNE_HOLD pulses, and the shutter state
+    machine gives the command again.  A pulse that already had the times
+    set with P and still did not get there is a stall.
+*/
+
+#include "ShutterJig.h"
+#include "shutter.h"
+#include "tune.h"
+
+#ifdef SENSE_ENABLE
+
+tune_t tune;
+
+// Start again from the times set with P.
+static void tune_reset(void)
+{
+  unsigned char i;
+
+  for(i = 0; i < 2; i++)
+  {
+    tune.margin[i] = TUNE_MARGIN_START;
+    tune.hold[i] = 0;
+    tune.travel[i] = 0;
+    tune.on_us[i] = shutters[0].on_us;
+    tune.dead_us[i] = shutters[0].dead_us;
+  }
+  tune.misses = 0;
+}
+
+void tune_init(void)
+{
+  tune.on = 0;
+  tune_reset();
+}
+
+// Start tuning, from the times set with P.
+void tune_start(void)
+{
+  tune_reset();
+  tune.on = 1;
+}
+
+// Times of the next pulse in a direction: the tuned ones, within those
+// set with P.
+void tune_times(unsigned char direction, unsigned long *on_us,
+                unsigned long *dead_us)
+{
+  unsigned char i;
+
+  if(!tune.on)
+    return;
+  i = direction - 1;
+  if(tune.on_us[i] < *on_us)
+    *on_us = tune.on_us[i];
+  if(tune.dead_us[i] < *dead_us)
+    *dead_us = tune.dead_us[i];
+}
+
+// The pulse and dead time in a direction are over and the shutter got
+// there.  Follow the travel time and bring the times down.
+void tune_done(unsigned char direction)
+{
+  unsigned short travel;
+  unsigned char i;
+
+  i = direction - 1;
+  if(!tune.on || sense.result[i] != SENSE_DONE)
+    return;
+
+  // The pulse given again after a miss starts part way along the
+  // travel, so its time is left out.
+  travel = sense.travel[i];
+  if(tune.hold[i] != TUNE_HOLD)
+  {
+    if(travel >= tune.travel[i])
+      tune.travel[i] = travel;
+    else
+      tune.travel[i] -= (tune.travel[i] - travel) / 8;
+  }
+
+  if(tune.hold[i])
+    tune.hold[i]--;
+  else
+  {
+    if(tune.margin[i] > TUNE_MARGIN_MIN)
+      tune.margin[i]--;
+    tune.dead_us[i] -= tune.dead_us[i] / TUNE_DEAD_STEP;
+    if(tune.dead_us[i] < TUNE_DEAD_MIN_US)
+      tune.dead_us[i] = TUNE_DEAD_MIN_US;
+  }
+  tune.on_us[i] = (tune.travel[i]
+                   + ((unsigned long) tune.travel[i] * tune.margin[i]) / 16)
+    * TB_US_PER_TICK;
+}
+
+// A pulse in a direction did not get there.  Returns 0 if it had the
+// times set with P, which makes it a stall; otherwise the times back
+// off and the command is to be given again.
+unsigned char tune_miss(unsigned char direction)
+{
+  unsigned char i;
+
+  i = direction - 1;
+  if(!tune.on || (tune.on_us[i] >= shutters[0].on_us
+                  && tune.dead_us[i] >= shutters[0].dead_us))
+    return 0;
+
+  tune.misses++;
+  tune.hold[i] = TUNE_HOLD;
+  tune.margin[i] *= 2;
+  if(tune.margin[i] > TUNE_MARGIN_MAX)
+    tune.margin[i] = TUNE_MARGIN_MAX;
+  tune.on_us[i] *= 2;
+  if(tune.on_us[i] > shutters[0].on_us)
+    tune.on_us[i] = shutters[0].on_us;
+  tune.dead_us[i] *= 2;
+  if(tune.dead_us[i] > shutters[0].dead_us)
+    tune.dead_us[i] = shutters[0].dead_us;
+  return 1;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*  Filename:       tune.h
+    Author:         Corey Davyduke
+    Created:        2026-10-17
+    Modified:       2026-10-17
+    Compiler:       GNU GCC
+    Description:    This is the header file for the pulse time tuning of
+    channel 0.  From the travel times measured by the end-of-travel
+    sensors (sense.h), the on and dead times of each direction are
+    brought down towards the shortest that still get the shutter there,
+    and backed off again when it does not.  The times set with P are the
+    upper limits.  Like the sensors, it is only built with SENSE_ENABLE.
+*/
+
+#ifndef _TUNE_H
+#define _TUNE_H
+
+/* Margin of the on time over the travel time, in 1/16ths: it starts at
+   TUNE_MARGIN_START, goes down by one each pulse that gets there, to
+   TUNE_MARGIN_MIN, and doubles after a miss.  */
+#define TUNE_MARGIN_START   16          /* 100% */
+#define TUNE_MARGIN_MIN     4           /* 25% */
+#define TUNE_MARGIN_MAX     64          /* 400% */
+
+/* Shortest dead time, and the share taken off it each pulse that gets
+   there (1/TUNE_DEAD_STEP).  */
+#define TUNE_DEAD_MIN_US    5000L
+#define TUNE_DEAD_STEP      8
+
+/* Pulses that must get there after a miss before the times go down
+   again.  */
+#define TUNE_HOLD           8
+
+/*! Tuned times, indexed by direction - 1 (PULSE_OPEN, PULSE_CLOSE).  */
+struct tune
+{
+  unsigned char on;                     /* != 0 while tuning */
+  unsigned char margin[2];
+  unsigned char hold[2];
+  unsigned short travel[2];             /* travel estimate, TCNT ticks */
+  unsigned long on_us[2];
+  unsigned long dead_us[2];
+  unsigned short misses;
+};
+typedef struct tune tune_t;
+
+#ifdef SENSE_ENABLE
+
+extern tune_t tune;
+
+extern void tune_init (void);
+extern void tune_start (void);
+extern void tune_times (unsigned char direction, unsigned long *on_us,
+                        unsigned long *dead_us);
+extern void tune_done (unsigned char direction);
+extern unsigned char tune_miss (unsigned char direction);
+
+#else
+
+#define tune_init()             do { } while(0)
+#define tune_times(D, ON, DEAD) do { } while(0)
+#define tune_done(D)            do { } while(0)
+#define tune_miss(D)            0
+
+#endif
+
+#endif